@@ -1,13 +1,25 @@
 #ifndef SLIGHT_H
 #define SLIGHT_H
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <iosfwd>
+#include <map>
 #include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 struct sqlite3;
+struct sqlite3_context;
+struct sqlite3_snapshot;
+struct sqlite3_stmt;
+struct sqlite3_value;
 
 namespace slight {
 
@@ -15,7 +27,18 @@ namespace slight {
 //   - write as many tests as possible. hundreds. make it a goal bc i'll write 'em small.
 //   - write at least one test per method/function
 // @todo ColumnType & Bind::DataType are the same mapping. combine?
-enum ColumnType { nil, i32, i64, u32, flt, text, blob, datetime };
+enum ColumnType { nil, i32, i64, u32, flt, text, blob, datetime, text_view };
+
+/// @brief Borrowed text and its length in bytes, valid as long as the
+///        pointer get<text> would have returned.
+///
+/// @note data is nullptr for NULL. Embedded NULs are kept.
+struct TextView {
+    const char* data;
+    std::size_t size;
+
+    std::string str() const { return data ? std::string(data, size) : std::string(); }
+};
 
 template<ColumnType type> struct Typer {};
 template<> struct                Typer<i32>  { typedef int32_t     Type; };
@@ -23,15 +46,264 @@ template<> struct                Typer<i64>  { typedef int64_t     Type; };
 template<> struct                Typer<u32>  { typedef uint32_t    Type; };
 template<> struct                Typer<flt>  { typedef double      Type; };
 template<> struct                Typer<text> { typedef const char* Type; };
+template<> struct                Typer<text_view> { typedef TextView Type; };
+
+/// @brief A UTC time with microsecond resolution.
+typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds> DateTime;
+template<> struct                Typer<datetime> { typedef DateTime Type; };
+
+/// @brief How Bind stores a DateTime.
+///
+/// epoch_micros: integer microseconds since 1970-01-01T00:00:00Z.
+/// iso8601:      text "YYYY-MM-DDTHH:MM:SS.ffffffZ". Always 27 bytes, so
+///               it sorts like the time it holds and sqlite's date and
+///               time functions read it as is.
+enum class DateTimeFormat { epoch_micros, iso8601 };
+
+/// @brief Bytes format_iso8601 writes (no terminator).
+constexpr std::size_t iso8601_size = 27;
+
+/// @brief Parse "YYYY-MM-DD", optionally followed by 'T' or ' ' and
+///        "HH:MM:SS", 1 or more fractional digits (truncated to micros)
+///        and 'Z' or a "+HH:MM" / "+HHMM" / "+HH" offset.
+///
+/// @note Does not allocate; digits and separators are checked 8 bytes at
+///       a time. Years 0000-9999 only.
+///
+/// @returns false, leaving out untouched, if text is not all one datetime.
+bool parse_iso8601(const char* text, std::size_t size, DateTime& out);
+
+/// @brief Write value in UTC as iso8601_size bytes to out.
+std::size_t format_iso8601(DateTime value, char* out);
+
+/// @brief A column value, or nothing for SQL NULL.
+///
+/// @note Stands in for std::optional, which C++11 lacks. value() of an
+///       empty Optional is a value-initialized T rather than an error.
+template<typename T>
+class Optional final {
+public:
+    Optional() : engaged(false), stored() {}
+    Optional(T value) : engaged(true), stored(value) {}
+
+    bool has_value() const { return engaged; }
+    explicit operator bool() const { return engaged; }
+    const T& value() const { return stored; }
+    const T& operator*() const { return stored; }
+    const T* operator->() const { return &stored; }
+    T value_or(T fallback) const { return engaged ? stored : fallback; }
+
+private:
+    bool engaged;
+    T stored;
+};
+
+/// @brief Borrowed blob bytes, valid until the value they came from changes.
+struct Blob {
+    const void* data;
+    std::size_t size;
+};
+
+/// @brief Output formats for Statement::write_to.
+///
+/// csv:    RFC 4180 with a header line of column names. NULL is an empty
+///         field, blobs are written as hex.
+/// ndjson: one JSON object per row keyed by column name. Blobs are hex
+///         strings, non-finite reals are null.
+/// binary: "SLT1", varint column count, then each column name as varint
+///         length + bytes. Each row is, per column, a tag byte (0 null,
+///         1 integer, 2 real, 3 text, 4 blob) followed by a zigzag varint
+///         for integers, 8 little-endian IEEE-754 bytes for reals, or a
+///         varint length + bytes for text and blobs.
+enum class Format { csv, ndjson, binary };
 
 struct Bind;
 struct Database;
+class ResultSet;
+struct ResultCacheStats;
+class Session;
+struct Conflict;
+
+/// @brief Kind of row change, as seen by sessions and change hooks.
+enum class ChangeOp { insert, update, remove };
+
+/// @brief Rows of one table changed the same way by a committed transaction.
+struct ChangeBatch {
+    std::string table;
+    ChangeOp op;
+    std::vector<int64_t> rowids;
+};
+
+/// @brief Receives everything one transaction changed, once it has committed.
+typedef std::function<void(const std::vector<ChangeBatch>& changes)> ChangeListener;
+
+/// @brief Binary changeset or patchset produced by a Session.
+typedef std::vector<unsigned char> Changeset;
+
+/// @brief What apply_changeset() does with a change that conflicts.
+///
+/// @note replace is only valid for Conflict::Type::data and ::conflict and
+///       is treated as omit otherwise.
+enum class ConflictAction { omit, replace, abort };
+typedef std::function<ConflictAction(const Conflict& conflict)> ConflictHandler;
+
+/// @brief How a connection waits out SQLITE_BUSY.
+///
+/// @note Each wait is drawn from [d/2, d], where d starts at initial_backoff
+///       and grows by multiplier per retry up to max_backoff. A lock event
+///       gives up once timeout has elapsed or after max_retries waits
+///       (negative means no retry limit).
+struct BusyPolicy {
+    std::chrono::milliseconds timeout{5000};
+    std::chrono::microseconds initial_backoff{100};
+    std::chrono::microseconds max_backoff{100000};
+    double multiplier{2.0};
+    int max_retries{-1};
+
+    /// @brief Also reset and re-run read-only statements that report
+    ///        SQLITE_BUSY before producing a row (cases sqlite does not
+    ///        route through the busy handler).
+    bool retry_reads{true};
+};
+
+struct BusyStats {
+    std::uint64_t events{0};   // lock events that had to wait
+    std::uint64_t retries{0};  // waits taken
+    std::uint64_t timeouts{0}; // events that gave up
+    std::chrono::microseconds waited{0};
+};
+
+/// @brief Decoded rows, stored row-major in one cell array plus one text arena.
+///
+/// @note Reused across Statement::step_batch calls without reallocating
+///       once it has grown to the batch size. get<text> pointers stay
+///       valid until the buffer is refilled, and are nullptr for values
+///       that were not stored as text.
+class RowBuffer final {
+public:
+    class Row {
+    public:
+        template<ColumnType type>
+        typename Typer<type>::Type get(int index) const;
+
+        /// @brief Copy text into out, reusing its capacity; NULL and
+        ///        non-text cells leave it empty.
+        void get_into(int index, std::string& out) const;
+
+        /// @brief get<type>, or nothing when the cell is NULL.
+        template<ColumnType type>
+        Optional<typename Typer<type>::Type> get_optional(int index) const
+        {
+            if (is_null(index))
+                return {};
+            return get<type>(index);
+        }
+
+        /// @brief How the cell is stored: nil, i64, flt, text or blob.
+        ColumnType column_type(int index) const;
+        bool is_null(int index) const;
+
+    private:
+        friend RowBuffer;
+        Row(const RowBuffer* buffer, std::size_t row) : buffer(buffer), row(row) {}
+
+        const RowBuffer* buffer;
+        std::size_t row;
+    };
+
+    std::size_t size() const { return n_rows; }
+    bool empty() const { return n_rows == 0; }
+    int columns() const { return n_columns; }
+    Row operator[](std::size_t row) const { return Row(this, row); }
+
+    /// @brief Drop the rows but keep the memory.
+    void clear();
+
+    /// @brief Memory held, including spare capacity.
+    std::size_t bytes() const;
+
+private:
+    friend struct Statement;
+    friend struct ResultCache;
+
+    struct Cell {
+        union {
+            int64_t i;
+            double f;
+            uint64_t offset; // into arena for text and blobs
+        };
+        uint32_t size;
+        uint8_t type;
+    };
+
+    const Cell& cell(std::size_t row, int index) const { return cells[row * n_columns + index - 1]; }
+
+    /// @brief Decode the row stmt is on.
+    ///
+    /// @returns bytes read, as counted by Metrics.
+    std::uint64_t append(sqlite3_stmt* stmt);
+
+    std::vector<Cell> cells;
+    std::string arena;
+    std::size_t n_rows = 0;
+    int n_columns = 0;
+};
+
+/// @brief Activity of one Database, see Database::metrics_snapshot().
+///
+/// @note bytes_bound and bytes_read count text and blob bytes plus 8 per
+///       other value, through bind(), get<>() and step_batch(). errors
+///       maps primary result codes to how often they were returned.
+///       The cache_* through stmt_used fields come from sqlite3_db_status.
+struct Metrics {
+    std::uint64_t prepares{0};
+    std::uint64_t result_cache_hits{0};
+    std::uint64_t steps{0};
+    std::uint64_t rows{0};
+    std::uint64_t bytes_bound{0};
+    std::uint64_t bytes_read{0};
+    std::uint64_t busy_waits{0};
+    std::uint64_t commits{0};
+    std::uint64_t rollbacks{0};
+    std::map<int, std::uint64_t> errors;
+
+    int cache_hit{0};
+    int cache_miss{0};
+    int cache_write{0};
+    int cache_used{0};          // bytes
+    int lookaside_used{0};      // slots
+    int lookaside_hit{0};
+    int lookaside_miss_size{0};
+    int lookaside_miss_full{0};
+    int schema_used{0};         // bytes
+    int stmt_used{0};           // bytes
+};
+
+/// @brief Outcome of Database::execute_script().
+struct ScriptResult {
+    struct Statement {
+        std::size_t offset;  // into the script
+        std::size_t length;
+        std::uint64_t rows;  // returned, and discarded
+        std::chrono::microseconds elapsed; // prepare and step
+    };
+
+    /// @brief The statements that ran, including a failing last one.
+    std::vector<Statement> statements;
+
+    int error_code{0};
+    std::string error_msg;
+
+    bool error() const { return error_code != 0; }
+};
 
 struct Statement {
     struct details;
     friend Database;
 
-    ~Statement() = default;
+    ~Statement();
+    Statement(const Statement&) = delete;
+    Statement& operator=(const Statement&) = delete;
 
     bool ready() const;
     bool has_row() const;
@@ -50,6 +322,46 @@ struct Statement {
     template<ColumnType type>
     typename Typer<type>::Type get(int index);
 
+    /// @brief Copy the column's text into out, reusing its capacity.
+    ///
+    /// @note Converts like get<text>; NULL leaves out empty.
+    void get_into(int index, std::string& out);
+
+    /// @brief get<type>, or nothing when the column is NULL.
+    ///
+    /// @note The storage class is read once; a non-NULL value then takes
+    ///       the same single conversion as get<type>.
+    template<ColumnType type>
+    Optional<typename Typer<type>::Type> get_optional(int index)
+    {
+        if (column_type(index) == nil)
+            return {};
+        return get<type>(index);
+    }
+
+    /// @brief Storage class of the column in the current row: nil, i64,
+    ///        flt, text or blob.
+    ColumnType column_type(int index) const;
+
+    /// @brief Step through every remaining row (starting with the current
+    ///        one, if any) and write it to fd or out.
+    ///
+    /// @note Rows are formatted straight from sqlite's column buffers into
+    ///       one reusable output buffer; no per-row strings are built. A
+    ///       failed write is reported through error() as SQLITE_IOERR.
+    ///
+    /// @returns the number of rows written.
+    std::size_t write_to(int fd, Format format);
+    std::size_t write_to(std::ostream& out, Format format);
+
+    /// @brief Step up to n more rows, decoding every column into buffer.
+    ///
+    /// @note buffer is cleared first. Stops early when the statement is
+    ///       done or fails; check done()/error() as after step().
+    ///
+    /// @returns the number of rows in buffer.
+    std::size_t step_batch(RowBuffer& buffer, std::size_t n);
+
 private:
     explicit Statement(details* me) : me(me) {}
 
@@ -58,7 +370,16 @@ private:
 
 struct Bind final {
     enum class Type { empty, index, column };
-    enum class DataType { i32, i64, u32, flt, str };
+    enum class DataType { i32, i64, u32, flt, str, iso8601, i64_array, flt_array, str_array };
+
+    /// @brief Borrowed view of a vector bound as a table-valued parameter.
+    ///
+    /// @note The vector is not copied. It must outlive every step() of the
+    ///       statement it is bound to, or until another value is bound.
+    struct Array {
+        const void* data;
+        std::size_t size;
+    };
 
     explicit Bind(int32_t value);
     explicit Bind(int64_t value);
@@ -75,6 +396,22 @@ struct Bind final {
     Bind(const char* column, uint32_t value);
     Bind(const char* column, float value);
     Bind(const char* column, const char* value);
+
+    /// @brief Bind a DateTime as an integer or, formatted when bound, as text.
+    explicit Bind(DateTime value, DateTimeFormat format = DateTimeFormat::epoch_micros);
+    Bind(int index, DateTime value, DateTimeFormat format = DateTimeFormat::epoch_micros);
+    Bind(const char* column, DateTime value, DateTimeFormat format = DateTimeFormat::epoch_micros);
+
+    /// @brief Bind a vector as a table for `carray(?)`, e.g. `WHERE id IN carray(?)`.
+    explicit Bind(const std::vector<int64_t>& values);
+    explicit Bind(const std::vector<double>& values);
+    explicit Bind(const std::vector<std::string>& values);
+    Bind(int index, const std::vector<int64_t>& values);
+    Bind(int index, const std::vector<double>& values);
+    Bind(int index, const std::vector<std::string>& values);
+    Bind(const char* column, const std::vector<int64_t>& values);
+    Bind(const char* column, const std::vector<double>& values);
+    Bind(const char* column, const std::vector<std::string>& values);
     ~Bind() = default;
 
     const Type type;
@@ -88,9 +425,326 @@ struct Bind final {
         const int64_t i;
         const float f;
         const char* str;
+        const Array array;
     };
 };
 
+/// @brief Plumbing that adapts C++ callables to sqlite's function callbacks.
+///
+/// @note Argument and result types are resolved at compile time, so a call
+///       is one sqlite3_value_* read per argument and one sqlite3_result_*.
+namespace function_details {
+
+int64_t value_i64(sqlite3_value* value);
+double value_flt(sqlite3_value* value);
+const char* value_text(sqlite3_value* value);
+Blob value_blob(sqlite3_value* value);
+
+void result_null(sqlite3_context* ctx);
+void result_i64(sqlite3_context* ctx, int64_t value);
+void result_flt(sqlite3_context* ctx, double value);
+void result_text(sqlite3_context* ctx, const char* value, std::size_t size);
+void result_blob(sqlite3_context* ctx, const void* value, std::size_t size);
+void result_error(sqlite3_context* ctx, const char* msg);
+void* user_data(sqlite3_context* ctx);
+void* aggregate_context(sqlite3_context* ctx, std::size_t size);
+void result_nomem(sqlite3_context* ctx);
+
+template<std::size_t...> struct indices {};
+template<std::size_t n, std::size_t... i> struct make_indices : make_indices<n - 1, n - 1, i...> {};
+template<std::size_t... i> struct make_indices<0, i...> { typedef indices<i...> type; };
+
+template<typename F> struct traits : traits<decltype(&F::operator())> {};
+template<typename R, typename... A> struct traits<R(*)(A...)> {
+    typedef R Result;
+    typedef std::tuple<typename std::decay<A>::type...> Args;
+    static const std::size_t arity = sizeof...(A);
+};
+template<typename R, typename... A> struct traits<R(A...)> : traits<R(*)(A...)> {};
+template<typename C, typename R, typename... A> struct traits<R(C::*)(A...)> : traits<R(*)(A...)> {};
+template<typename C, typename R, typename... A> struct traits<R(C::*)(A...) const> : traits<R(*)(A...)> {};
+
+template<typename T, typename Enable = void> struct Arg;
+template<typename T> struct Arg<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    static T get(sqlite3_value* value) { return static_cast<T>(value_i64(value)); }
+};
+template<typename T> struct Arg<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static T get(sqlite3_value* value) { return static_cast<T>(value_flt(value)); }
+};
+template<> struct Arg<const char*> {
+    static const char* get(sqlite3_value* value) { return value_text(value); }
+};
+template<> struct Arg<std::string> {
+    static std::string get(sqlite3_value* value)
+    {
+        // blob then size, the order sqlite recommends to avoid a conversion
+        auto bytes = value_blob(value);
+        return std::string(static_cast<const char*>(bytes.data), bytes.size);
+    }
+};
+template<> struct Arg<Blob> {
+    static Blob get(sqlite3_value* value) { return value_blob(value); }
+};
+
+template<typename T, typename Enable = void> struct Result;
+template<typename T> struct Result<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    static void set(sqlite3_context* ctx, T value) { result_i64(ctx, static_cast<int64_t>(value)); }
+};
+template<typename T> struct Result<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static void set(sqlite3_context* ctx, T value) { result_flt(ctx, static_cast<double>(value)); }
+};
+template<> struct Result<const char*> {
+    static void set(sqlite3_context* ctx, const char* value)
+    {
+        if (value)
+            result_text(ctx, value, std::char_traits<char>::length(value));
+        else
+            result_null(ctx);
+    }
+};
+template<> struct Result<std::string> {
+    static void set(sqlite3_context* ctx, const std::string& value) { result_text(ctx, value.data(), value.size()); }
+};
+template<> struct Result<Blob> {
+    static void set(sqlite3_context* ctx, const Blob& value) { result_blob(ctx, value.data, value.size); }
+};
+
+template<typename R> struct Invoke {
+    template<typename F, typename... A, std::size_t... i>
+    static void call(F& f, sqlite3_context* ctx, sqlite3_value** argv, std::tuple<A...>*, indices<i...>)
+    {
+        Result<typename std::decay<R>::type>::set(ctx, f(Arg<A>::get(argv[i])...));
+    }
+};
+template<> struct Invoke<void> {
+    template<typename F, typename... A, std::size_t... i>
+    static void call(F& f, sqlite3_context* ctx, sqlite3_value** argv, std::tuple<A...>*, indices<i...>)
+    {
+        f(Arg<A>::get(argv[i])...);
+        result_null(ctx);
+    }
+};
+
+template<typename F>
+void scalar(sqlite3_context* ctx, int, sqlite3_value** argv)
+{
+    typedef traits<F> Traits;
+    auto& f = *static_cast<F*>(user_data(ctx));
+    try
+    {
+        Invoke<typename Traits::Result>::call(
+            f, ctx, argv,
+            static_cast<typename Traits::Args*>(nullptr),
+            typename make_indices<Traits::arity>::type());
+    }
+    catch (const std::exception& e)
+    {
+        result_error(ctx, e.what());
+    }
+}
+
+template<typename T>
+void destroy(void* p) { delete static_cast<T*>(p); }
+
+template<typename Tuple> struct tail;
+template<typename H, typename... T> struct tail<std::tuple<H, T...>> { typedef std::tuple<T...> type; };
+
+/// @brief Per-group aggregate state, constructed in place inside the zeroed
+///        sqlite3_aggregate_context memory so no group allocates on its own.
+template<typename State>
+struct Slot {
+    bool constructed;
+    typename std::aligned_storage<sizeof(State), alignof(State)>::type storage;
+
+    State& state() { return *reinterpret_cast<State*>(&storage); }
+};
+
+template<typename State, typename Step, typename Final, typename Inverse>
+struct Aggregate {
+    typedef typename tail<typename traits<Step>::Args>::type Args;
+    static const std::size_t arity = traits<Step>::arity - 1;
+
+    Step step;
+    Final final;
+    Inverse inverse;
+
+    static Slot<State>* slot(sqlite3_context* ctx, bool create)
+    {
+        auto slot = static_cast<Slot<State>*>(aggregate_context(ctx, create ? sizeof(Slot<State>) : 0));
+        if (slot && !slot->constructed)
+        {
+            new (&slot->storage) State();
+            slot->constructed = true;
+        }
+        return slot;
+    }
+
+    template<typename F, typename... A, std::size_t... i>
+    static void call(F& f, State& state, sqlite3_value** argv, std::tuple<A...>*, indices<i...>)
+    {
+        f(state, Arg<A>::get(argv[i])...);
+    }
+
+    template<typename F>
+    static void apply(sqlite3_context* ctx, sqlite3_value** argv, F Aggregate::* member)
+    {
+        auto me = static_cast<Aggregate*>(user_data(ctx));
+        auto slot = Aggregate::slot(ctx, true);
+        if (!slot)
+            return result_nomem(ctx);
+
+        try
+        {
+            call(me->*member, slot->state(), argv, static_cast<Args*>(nullptr), typename make_indices<arity>::type());
+        }
+        catch (const std::exception& e)
+        {
+            result_error(ctx, e.what());
+        }
+    }
+
+    static void result(sqlite3_context* ctx, bool done)
+    {
+        auto me = static_cast<Aggregate*>(user_data(ctx));
+        auto slot = Aggregate::slot(ctx, false);
+        try
+        {
+            if (slot)
+            {
+                Result<typename std::decay<typename traits<Final>::Result>::type>::set(ctx, me->final(slot->state()));
+            }
+            else
+            {
+                // no rows in the group, sqlite never allocated the context
+                State empty{};
+                Result<typename std::decay<typename traits<Final>::Result>::type>::set(ctx, me->final(empty));
+            }
+        }
+        catch (const std::exception& e)
+        {
+            result_error(ctx, e.what());
+        }
+
+        if (slot && done)
+            slot->state().~State();
+    }
+
+    static void x_step(sqlite3_context* ctx, int, sqlite3_value** argv) { apply(ctx, argv, &Aggregate::step); }
+    static void x_inverse(sqlite3_context* ctx, int, sqlite3_value** argv) { apply(ctx, argv, &Aggregate::inverse); }
+    static void x_value(sqlite3_context* ctx) { result(ctx, false); }
+    static void x_final(sqlite3_context* ctx) { result(ctx, true); }
+};
+
+/// @brief Placeholder inverse for aggregates that are not window functions.
+struct NoInverse {
+    template<typename... A> void operator()(A&&...) const {}
+};
+
+} // namespace function_details
+
+/// @brief Plumbing that presents an in-memory range as a read-only virtual table.
+namespace vtab_details {
+
+enum class Kind { null, integer, real, text };
+
+/// @brief A borrowed cell value. Text points into the caller's row.
+struct Value {
+    Kind kind;
+    int64_t i;
+    double f;
+    const char* str;
+    std::size_t size;
+};
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, Value>::type to_value(const T& value)
+    { return Value{Kind::integer, static_cast<int64_t>(value), 0, nullptr, 0}; }
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, Value>::type to_value(const T& value)
+    { return Value{Kind::real, 0, static_cast<double>(value), nullptr, 0}; }
+inline Value to_value(const std::string& value)
+    { return Value{Kind::text, 0, 0, value.data(), value.size()}; }
+inline Value to_value(const char* value)
+{
+    return value
+        ? Value{Kind::text, 0, 0, value, std::char_traits<char>::length(value)}
+        : Value{Kind::null, 0, 0, nullptr, 0};
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, const char*>::type declared_type(const T*) { return "INTEGER"; }
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, const char*>::type declared_type(const T*) { return "REAL"; }
+inline const char* declared_type(const std::string*) { return "TEXT"; }
+inline const char* declared_type(const char* const*) { return "TEXT"; }
+
+struct Column {
+    std::string name;
+    const char* type;
+    bool key;
+    std::function<Value(const void* row)> get;
+};
+
+struct Table {
+    std::function<std::size_t()> size;
+    std::function<const void*(std::size_t)> row;
+    std::vector<Column> columns;
+};
+
+} // namespace vtab_details
+
+/// @brief Column of a Row exposed by Database::register_vtab.
+template<typename Row>
+struct VtabColumn {
+    vtab_details::Column column;
+};
+
+/// @brief Expose a Row member as a column.
+template<typename Row, typename T>
+VtabColumn<Row> column(const std::string& name, T Row::* member)
+{
+    return VtabColumn<Row>{{
+        name,
+        vtab_details::declared_type(static_cast<const T*>(nullptr)),
+        false,
+        [member](const void* row) { return vtab_details::to_value(static_cast<const Row*>(row)->*member); }}};
+}
+
+/// @brief Expose a Row member as the key column.
+///
+/// @note The range must be sorted ascending by this column. Equality and
+///       range constraints on it are answered by binary search instead of
+///       a full scan, and ORDER BY on it needs no sort.
+template<typename Row, typename T>
+VtabColumn<Row> key_column(const std::string& name, T Row::* member)
+{
+    auto c = column(name, member);
+    c.column.key = true;
+    return c;
+}
+
+/// @brief A point in the history of a WAL database, see Database::snapshot().
+class Snapshot final {
+public:
+    ~Snapshot();
+
+    bool error() const { return errcode != 0; }
+    int error_code() const { return errcode; }
+    const std::string& error_msg() const { return errmsg; }
+
+    /// @brief Negative, zero or positive as this snapshot is older than, the
+    ///        same as or newer than other. Both must come from the same database.
+    int compare(const Snapshot& other) const;
+
+private:
+    friend Database;
+    Snapshot() = default;
+
+    sqlite3_snapshot* handle{nullptr};
+    int errcode{0};
+    std::string errmsg;
+};
+
 class Database final {
 public:
     struct details;
@@ -104,7 +758,16 @@ public:
     static std::unique_ptr<Database> make_create_read_write(const std::string& path);
 
     explicit Database(details* me) : me(me) {}
-    ~Database() = default;
+    Database(Database&& other) : me(other.me) { other.me = nullptr; }
+    Database& operator=(Database&& other);
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    /// @brief Close the connection.
+    ///
+    /// @note Statements, sessions and results of this database have to be
+    ///       released first.
+    ~Database();
 
     std::shared_ptr<Statement> prepare(const std::string& statement);
     // should i have a prepare_new_connection so statements don't use the same db connection?
@@ -112,6 +775,99 @@ public:
     std::shared_ptr<Statement> get_schema_version();
     std::shared_ptr<Statement> set_schema_version(SchemaVersion version);
 
+    /// @brief Register a C++ callable as a scalar SQL function.
+    ///
+    /// @note Argument and result types are deduced from the callable's signature.
+    ///       Arguments may be integral, floating point, const char*, std::string
+    ///       or Blob; results may also be void (NULL). const char* and Blob
+    ///       arguments point into sqlite's own buffers and are not copied.
+    /// @note Anything the callable captures is per-function state. It is owned
+    ///       by the connection and destroyed when the function is replaced or
+    ///       the database is closed.
+    /// @note Deterministic functions may be used in indexes and constant-folded
+    ///       by the planner.
+    ///
+    /// @returns false if sqlite rejected the registration.
+    template<typename F>
+    bool register_function(const std::string& name, F function, bool deterministic = true)
+    {
+        typedef typename std::decay<F>::type Function;
+        return create_function(
+            name,
+            static_cast<int>(function_details::traits<Function>::arity),
+            deterministic,
+            new Function(std::move(function)),
+            &function_details::scalar<Function>,
+            &function_details::destroy<Function>);
+    }
+
+    /// @brief Keep materialized results of read-only queries run through query().
+    ///
+    /// @note Entries are keyed by the SQL, with whitespace outside literals
+    ///       and comments collapsed, plus the bound values, and the whole
+    ///       cache is dropped as soon as
+    ///       PRAGMA data_version (commits by other connections) or
+    ///       sqlite3_total_changes (this connection) moves. Schema changes
+    ///       made by this connection alone are not detected.
+    ///       Least recently used entries are evicted past max_bytes.
+    void enable_result_cache(std::size_t max_bytes);
+    void disable_result_cache();
+    ResultCacheStats result_cache_stats() const;
+
+    /// @brief Wait out lock contention per policy instead of failing at once.
+    void set_busy_policy(const BusyPolicy& policy);
+    void clear_busy_policy();
+    BusyStats busy_stats() const;
+
+    /// @brief Run every statement in sql[0, size), in order, until one fails.
+    ///
+    /// @note Statements are prepared in place from the buffer, advancing by
+    ///       sqlite's tail pointer, and stepped to completion. With
+    ///       transaction the script runs inside one BEGIN ... COMMIT and is
+    ///       rolled back on failure; it must not contain its own BEGIN.
+    ScriptResult execute_script(const char* sql, std::size_t size, bool transaction = false);
+
+    /// @brief Start recording changes to tables (all tables if empty).
+    ///
+    /// @note Requires sqlite built with SQLITE_ENABLE_SESSION and
+    ///       SQLITE_ENABLE_PREUPDATE_HOOK; otherwise the session reports an
+    ///       error. Include slight_session.h to use it, and release it
+    ///       before the Database.
+    std::shared_ptr<Session> start_session(const std::vector<std::string>& tables = {});
+
+    /// @brief Apply a changeset or patchset from another database.
+    ///
+    /// @note Runs in one savepoint. on_conflict decides each conflicting
+    ///       change; without it the first conflict aborts and nothing is
+    ///       applied. An exception from on_conflict aborts it too, and is
+    ///       rethrown here once the changes are rolled back.
+    ///
+    /// @returns false if the changeset was malformed or aborted.
+    bool apply_changeset(const Changeset& changes, const ConflictHandler& on_conflict = nullptr);
+
+    /// @brief Call listener after each commit with the rows it changed.
+    ///
+    /// @note Changes are buffered per transaction through sqlite3_update_hook
+    ///       and grouped by (table, op) in order of first appearance; a
+    ///       rollback discards them. Listeners run on the thread whose step
+    ///       completed the commit, and may use the connection. As with the
+    ///       update hook, WITHOUT ROWID tables, REPLACE conflict deletions
+    ///       and truncating DELETEs are not reported, and changes undone by
+    ///       a ROLLBACK TO issued through SQL are still delivered.
+    ///
+    /// @returns an id for unsubscribe_changes().
+    std::size_t subscribe_changes(ChangeListener listener);
+    void unsubscribe_changes(std::size_t id);
+
+    /// @brief Totals of the counters every Database keeps, plus sqlite3_db_status.
+    Metrics metrics_snapshot() const;
+
+    /// @brief Run sql to completion and return every row, materialized.
+    ///
+    /// @note Served from the result cache when it is enabled and valid.
+    ///       Include slight_cache.h to read the ResultSet.
+    std::shared_ptr<const ResultSet> query(const std::string& sql, std::initializer_list<const Bind> binds = {});
+
     /// @brief Path to database on disk.
     const std::string& path() const;
 
@@ -121,7 +877,122 @@ public:
     /// @brief Error message if the database failed to open.
     const std::string& error_msg() const;
 
+    /// @brief The underlying connection, for anything slight does not wrap.
+    sqlite3* handle() const;
+
+    /// @brief Capture the snapshot this connection reads.
+    ///
+    /// @note Outside a transaction this starts a read transaction first,
+    ///       which stays open until end_read() so that checkpoints cannot
+    ///       invalidate the snapshot meanwhile. The database must be in WAL
+    ///       mode and sqlite built with SQLITE_ENABLE_SNAPSHOT; otherwise
+    ///       the snapshot reports an error.
+    std::shared_ptr<Snapshot> snapshot();
+
+    /// @brief Start a read transaction on this connection that sees exactly
+    ///        snapshot, taken on any connection to the same database.
+    ///
+    /// @returns false if the snapshot is no longer available, this
+    ///          connection is already in a transaction, or snapshots are
+    ///          not compiled in.
+    bool open_snapshot(const Snapshot& snapshot);
+
+    /// @brief End the read transaction started by snapshot() or open_snapshot().
+    void end_read();
+
+    /// @brief Register an aggregate SQL function whose per-group state is a State.
+    ///
+    /// @note step is called as step(State&, args...) for each row and final as
+    ///       final(State&) to produce the result. The State is default
+    ///       constructed in place in sqlite3_aggregate_context memory, so
+    ///       groups do not allocate on their own, and destroyed after final.
+    ///
+    /// @returns false if sqlite rejected the registration.
+    template<typename State, typename Step, typename Final>
+    bool register_aggregate(const std::string& name, Step step, Final final, bool deterministic = true)
+    {
+        typedef function_details::Aggregate<State, Step, Final, function_details::NoInverse> Aggregate;
+        return create_aggregate(
+            name,
+            static_cast<int>(Aggregate::arity),
+            deterministic,
+            new Aggregate{std::move(step), std::move(final), function_details::NoInverse()},
+            &Aggregate::x_step,
+            &Aggregate::x_final,
+            nullptr,
+            nullptr,
+            &function_details::destroy<Aggregate>);
+    }
+
+    /// @brief Register an aggregate that can also be used as a window function.
+    ///
+    /// @note inverse is called as inverse(State&, args...) when a row leaves
+    ///       the window frame. final may be called more than once per group.
+    template<typename State, typename Step, typename Final, typename Inverse>
+    bool register_aggregate(const std::string& name, Step step, Final final, Inverse inverse, bool deterministic = true)
+    {
+        typedef function_details::Aggregate<State, Step, Final, Inverse> Aggregate;
+        return create_aggregate(
+            name,
+            static_cast<int>(Aggregate::arity),
+            deterministic,
+            new Aggregate{std::move(step), std::move(final), std::move(inverse)},
+            &Aggregate::x_step,
+            &Aggregate::x_final,
+            &Aggregate::x_value,
+            &Aggregate::x_inverse,
+            &function_details::destroy<Aggregate>);
+    }
+
+    /// @brief Present an in-memory random-access range as a read-only table.
+    ///
+    /// @note The table is eponymous: it is queried as `name` directly and is
+    ///       never written to the database schema. Rows are read in place,
+    ///       nothing is copied, so rows stays borrowed and must outlive the
+    ///       registration. It may change between statements but not while a
+    ///       statement is reading it.
+    ///
+    /// e.g. db.register_vtab("orders", orders, {
+    ///          slight::key_column("id", &Order::id),
+    ///          slight::column("symbol", &Order::symbol)});
+    ///
+    /// @returns false if sqlite rejected the registration.
+    template<typename Range, typename Row>
+    bool register_vtab(const std::string& name, const Range& rows, std::initializer_list<VtabColumn<Row>> columns)
+    {
+        auto table = new vtab_details::Table();
+        table->size = [&rows]() { return static_cast<std::size_t>(rows.size()); };
+        table->row = [&rows](std::size_t i) { return static_cast<const void*>(&rows[i]); };
+        for (const auto& c : columns)
+            table->columns.push_back(c.column);
+        return create_module(name, table);
+    }
+
 private:
+    typedef void (*ScalarFunction)(sqlite3_context*, int, sqlite3_value**);
+    typedef void (*FinalFunction)(sqlite3_context*);
+
+    bool create_function(
+        const std::string& name,
+        int n_args,
+        bool deterministic,
+        void* state,
+        ScalarFunction function,
+        void (*destroy)(void*));
+
+    bool create_aggregate(
+        const std::string& name,
+        int n_args,
+        bool deterministic,
+        void* state,
+        ScalarFunction step,
+        FinalFunction final,
+        FinalFunction value,
+        ScalarFunction inverse,
+        void (*destroy)(void*));
+
+    bool create_module(const std::string& name, vtab_details::Table* table);
+
     details* me;
 };
 
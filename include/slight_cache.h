@@ -0,0 +1,53 @@
+#ifndef SLIGHT_CACHE_H
+#define SLIGHT_CACHE_H
+
+#include "slight.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace slight {
+
+/// @brief A fully materialized query result.
+///
+/// @note Reading a cached result never touches sqlite.
+class ResultSet final {
+public:
+    typedef RowBuffer::Row Row;
+
+    std::size_t size() const { return rows.size(); }
+    bool empty() const { return rows.empty(); }
+    int columns() const { return static_cast<int>(names.size()); }
+    const std::string& column_name(int index) const { return names[index - 1]; }
+    Row operator[](std::size_t row) const { return rows[row]; }
+
+    bool error() const { return errcode != 0; }
+    int error_code() const { return errcode; }
+    const std::string& error_msg() const { return errmsg; }
+
+    /// @brief Approximate memory held by the result.
+    std::size_t bytes() const;
+
+private:
+    friend Database;
+    friend struct ResultCache;
+
+    std::vector<std::string> names;
+    RowBuffer rows;
+    int errcode = 0;
+    std::string errmsg;
+};
+
+struct ResultCacheStats {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t invalidations = 0;
+    std::size_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_CACHE_H
@@ -0,0 +1,63 @@
+#ifndef SLIGHT_CSV_H
+#define SLIGHT_CSV_H
+
+#include <cstddef>
+#include <string>
+
+namespace slight {
+
+class Database;
+
+struct CsvOptions {
+    /// @brief Field separator, ',' for CSV and '\t' for TSV.
+    char delimiter = ',';
+    char quote = '"';
+
+    /// @brief The first record holds column names rather than data.
+    bool header = true;
+
+    /// @brief Create the table from the header (or c1..cN) if it does not exist.
+    bool create_table = false;
+
+    /// @brief Store fields that look like integers or reals as such instead of text.
+    ///
+    /// @note Quoted fields are always text and empty fields are NULL.
+    bool convert_types = true;
+
+    /// @brief Parser threads, 0 for one per hardware thread.
+    unsigned threads = 0;
+
+    /// @brief Rows a parser hands to the writer at a time.
+    std::size_t batch_rows = 4096;
+
+    /// @brief Rows committed per transaction.
+    std::size_t transaction_rows = 500000;
+
+    /// @brief Rows per multi-row INSERT, 0 for 128. Either is lowered to
+    ///        fit sqlite's variable limit.
+    std::size_t rows_per_statement = 0;
+};
+
+struct CsvResult {
+    std::size_t rows = 0;
+    std::string error_msg;
+
+    bool error() const { return !error_msg.empty(); }
+};
+
+/// @brief Bulk load a CSV/TSV file into table.
+///
+/// @note The file is mmapped and split at record boundaries (quote aware)
+///       into one chunk per thread. Threads parse and type-convert their
+///       chunk into batches while the calling thread inserts the batches
+///       through cached multi-row INSERTs in large transactions. Rows of
+///       different chunks may be inserted out of file order.
+/// @note Blank lines are skipped, except in a single column file where
+///       they are rows holding NULL.
+/// @note On error the current transaction is rolled back; transactions
+///       committed before it are kept.
+CsvResult load_csv(Database& db, const std::string& table, const std::string& path, const CsvOptions& options = CsvOptions());
+
+} // namespace slight
+
+#endif // SLIGHT_CSV_H
@@ -0,0 +1,159 @@
+#ifndef SLIGHT_FTS_H
+#define SLIGHT_FTS_H
+
+#include "slight.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace slight {
+
+struct FullTextOptions {
+    /// @brief FTS5 tokenize= argument, e.g. "porter unicode61".
+    std::string tokenize = "unicode61";
+
+    /// @brief Documents add() commits per transaction, when it is not
+    ///        called inside one already.
+    std::size_t transaction_documents = 50000;
+
+    /// @brief Merge settings while add() runs. No incremental merging and a
+    ///        high crisis threshold let segments pile up cheaply; optimize()
+    ///        or later writes merge them.
+    ///
+    /// @note add() reads the table's own automerge and crisismerge first
+    ///       and puts them back before its final COMMIT.
+    int load_automerge = 0;
+    int load_crisismerge = 64;
+};
+
+struct FullTextDocument {
+    std::int64_t rowid;
+    std::vector<std::string> columns; // in the index's column order
+};
+
+struct FullTextQuery {
+    std::size_t limit = 10;
+    std::size_t offset = 0;
+
+    /// @brief Per column bm25 weights; missing columns weigh 1.
+    std::vector<double> weights;
+
+    /// @brief Column the snippet is taken from, -1 for the best match.
+    int snippet_column = -1;
+    int snippet_tokens = 16; // 1 to 64
+    std::string open = "[";
+    std::string close = "]";
+    std::string ellipsis = "...";
+};
+
+struct FullTextHit {
+    std::int64_t rowid;
+    double rank; // bm25, more negative for better matches
+    std::string snippet;
+};
+
+/// @brief Hits of FullTextIndex::search(), best first, read as they are
+///        stepped.
+///
+/// @note A single pass: begin() starts stepping and iterators share the
+///       current hit. Check error() after the loop.
+class FullTextResults final {
+public:
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef FullTextHit value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const FullTextHit* pointer;
+        typedef const FullTextHit& reference;
+
+        reference operator*() const;
+        pointer operator->() const { return &**this; }
+        iterator& operator++();
+        bool operator==(const iterator& other) const { return results == other.results; }
+        bool operator!=(const iterator& other) const { return results != other.results; }
+
+    private:
+        friend FullTextResults;
+        explicit iterator(FullTextResults* results) : results(results) {}
+
+        FullTextResults* results;
+    };
+
+    FullTextResults(FullTextResults&& other);
+    ~FullTextResults();
+
+    iterator begin();
+    iterator end() { return iterator(nullptr); }
+
+    bool error() const;
+    int error_code() const;
+    const std::string& error_msg() const;
+
+    struct details;
+
+private:
+    friend class FullTextIndex;
+    explicit FullTextResults(std::unique_ptr<details> me);
+
+    bool next();
+
+    std::unique_ptr<details> me;
+};
+
+/// @brief An FTS5 table: bulk loading, ranked MATCH queries and merging.
+///
+/// @note Needs sqlite built with SQLITE_ENABLE_FTS5; otherwise creating
+///       the table fails with "no such module: fts5". Uses db's connection,
+///       so it has db's threading rules.
+class FullTextIndex final {
+public:
+    /// @brief Use table, creating it over columns if it does not exist.
+    FullTextIndex(Database& db, const std::string& table, const std::vector<std::string>& columns,
+                  const FullTextOptions& options = FullTextOptions());
+
+    bool error() const { return errcode != 0; }
+    int error_code() const { return errcode; }
+    const std::string& error_msg() const { return errmsg; }
+
+    /// @brief Index documents, replacing any with the same rowid.
+    ///
+    /// @note Runs in transactions of options.transaction_documents unless
+    ///       a transaction is already open. On error the open transaction
+    ///       is rolled back; earlier ones stay committed.
+    ///
+    /// @returns the documents committed (or written, inside a caller's
+    ///          transaction).
+    std::size_t add(const std::vector<FullTextDocument>& documents);
+
+    bool remove(std::int64_t rowid);
+
+    /// @brief Run an FTS5 MATCH expression, ranked by bm25.
+    FullTextResults search(const std::string& match, const FullTextQuery& query = FullTextQuery());
+
+    /// @brief Merge every segment into one, for the fastest queries.
+    bool optimize();
+
+private:
+    bool exec(const std::string& sql);
+    bool configure(const char* setting, int value);
+    int setting(const char* name, int fallback);
+    bool fail(); // from the connection's last error
+
+    Database& db;
+    std::string table;
+    std::string quoted;
+    std::string insert_columns; // ", col1, col2..."
+    std::size_t n_columns;
+    FullTextOptions options;
+    int errcode{0};
+    std::string errmsg;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_FTS_H
@@ -0,0 +1,45 @@
+#ifndef SLIGHT_JSON_H
+#define SLIGHT_JSON_H
+
+#include "slight.h"
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <string>
+
+namespace slight {
+
+/// @brief Column indexes of json_each() and json_tree() rows, for get<>.
+///
+/// @note type is one of 'null', 'true', 'false', 'integer', 'real',
+///       'text', 'array' or 'object'. value and atom come back as sqlite
+///       values, so get<i64> or get<flt> read numbers without parsing.
+struct JsonEach {
+    enum : int { key = 1, value, type, atom, id, parent, fullkey, path };
+};
+
+/// @brief Statement over json_each(json, path), bound and ready to step().
+///
+/// @note json is bound without being copied and must outlive the steps.
+///       path nullptr walks the top level. Malformed JSON is reported by
+///       the first step() through error().
+std::shared_ptr<Statement> json_each(Database& db, const char* json, const char* path = nullptr);
+
+/// @brief As json_each(), but walks every element below path recursively.
+std::shared_ptr<Statement> json_tree(Database& db, const char* json, const char* path = nullptr);
+
+/// @brief Extract paths from json in one statement, positioned on its row.
+///
+/// @note Column i is json_extract(json, paths[i - 1]), read with get<>:
+///       numbers are integers or reals, strings are text, and arrays or
+///       objects are minified JSON text. Missing paths are NULL.
+std::shared_ptr<Statement> json_extract(Database& db, const char* json, std::initializer_list<const char*> paths);
+
+/// @brief Append str to out as a quoted, escaped JSON string, e.g. to
+///        build a document to bind.
+void json_quote(std::string& out, const char* str, std::size_t size);
+
+} // namespace slight
+
+#endif // SLIGHT_JSON_H
@@ -0,0 +1,55 @@
+#ifndef SLIGHT_PREFETCH_H
+#define SLIGHT_PREFETCH_H
+
+#include "slight.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace slight {
+
+struct PrefetchOptions {
+    /// @brief Rows decoded per batch.
+    std::size_t batch_rows = 256;
+
+    /// @brief Batches the producer may run ahead of the consumer.
+    std::size_t depth = 4;
+};
+
+/// @brief Steps a statement on a background thread while the caller
+///        consumes earlier rows.
+///
+/// @note The producer decodes batches with Statement::step_batch into a
+///       single-producer single-consumer ring of RowBuffers and blocks when
+///       the ring is full. Neither side takes a lock unless it has to
+///       sleep. The statement, and its connection, belong to the producer
+///       until next() returns nullptr or the cursor is destroyed.
+class PrefetchCursor final {
+public:
+    explicit PrefetchCursor(std::shared_ptr<Statement> statement, const PrefetchOptions& options = PrefetchOptions());
+    ~PrefetchCursor();
+
+    PrefetchCursor(const PrefetchCursor&) = delete;
+    PrefetchCursor& operator=(const PrefetchCursor&) = delete;
+
+    /// @brief The next batch, or nullptr once the statement is done or failed.
+    ///
+    /// @note The batch stays valid until the following call; calling again
+    ///       hands its buffer back to the producer.
+    const RowBuffer* next();
+
+    /// @brief The statement's outcome, once next() has returned nullptr.
+    bool error() const;
+    int error_code() const;
+    const std::string& error_msg() const;
+
+    struct details;
+
+private:
+    std::unique_ptr<details> me;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_PREFETCH_H
@@ -0,0 +1,73 @@
+#ifndef SLIGHT_QUEUE_H
+#define SLIGHT_QUEUE_H
+
+#include "slight.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace slight {
+
+/// @brief A unit of work run on the writer thread inside the shared transaction.
+///
+/// @note Return SQLITE_OK, SQLITE_ROW or SQLITE_DONE (e.g. a statement's
+///       error_code()) on success. Any other code, or an exception, rolls
+///       back just this job's changes.
+typedef std::function<int(Database& db)> WriteJob;
+
+struct WriteQueueOptions {
+    /// @brief Most jobs committed by one transaction.
+    std::size_t max_batch = 1024;
+
+    /// @brief How long an open batch waits for more jobs once the queue
+    ///        runs dry, measured from the batch's first job.
+    std::chrono::microseconds max_latency{1000};
+};
+
+struct WriteQueueStats {
+    std::uint64_t jobs = 0;
+    std::uint64_t batches = 0;    // transactions committed or attempted
+    std::uint64_t failed_jobs = 0;
+};
+
+/// @brief Single writer fed by any number of threads, with group commit.
+///
+/// @note Jobs are pushed onto a lock-free MPSC queue; producers only touch
+///       a mutex to wake an idle writer. The writer drains jobs into one
+///       BEGIN IMMEDIATE ... COMMIT, each job under its own savepoint, and
+///       completes the jobs' futures only after COMMIT returns. If COMMIT
+///       fails every future in the batch gets its error code.
+/// @note The queue takes the connection over; it must not be used by any
+///       other thread afterwards. The destructor finishes queued jobs.
+class WriteQueue final {
+public:
+    explicit WriteQueue(std::unique_ptr<Database> db, const WriteQueueOptions& options = WriteQueueOptions());
+    ~WriteQueue();
+
+    WriteQueue(const WriteQueue&) = delete;
+    WriteQueue& operator=(const WriteQueue&) = delete;
+
+    /// @brief Queue job; the future holds SQLITE_OK or the failing code.
+    std::future<int> submit(WriteJob job);
+
+    /// @brief Queue a single statement without bindings.
+    ///
+    /// @note The writer keeps such statements prepared for reuse.
+    std::future<int> submit(const std::string& sql);
+
+    WriteQueueStats stats() const;
+
+    struct details;
+
+private:
+    std::unique_ptr<details> me;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_QUEUE_H
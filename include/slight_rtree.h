@@ -0,0 +1,143 @@
+#ifndef SLIGHT_RTREE_H
+#define SLIGHT_RTREE_H
+
+#include "slight.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace slight {
+
+namespace spatial_details {
+
+enum class Relation { intersecting, within, containing };
+
+/// @brief The untyped half of SpatialIndex: the table and its statements.
+///
+/// @note Statements are prepared once on db's connection and bind the
+///       coordinates as doubles or ints directly, so a probe is one step
+///       loop with no SQL text built.
+class Index final {
+public:
+    Index(Database& db, const std::string& table, std::size_t dims, bool integer);
+    ~Index();
+    Index(const Index&) = delete;
+    Index& operator=(const Index&) = delete;
+
+    /// @brief The last call's error, or the constructor's, which sticks.
+    bool error() const { return errcode != 0; }
+    int error_code() const { return errcode; }
+    const std::string& error_msg() const { return errmsg; }
+
+    /// @returns whether a transaction was opened, to hand to end().
+    bool begin();
+    bool insert(std::int64_t rowid, const double* min, const double* max);
+    bool insert(std::int64_t rowid, const std::int32_t* min, const std::int32_t* max);
+    std::size_t end(bool opened, std::size_t inserted);
+
+    bool remove(std::int64_t rowid);
+
+    bool query(Relation relation, const double* min, const double* max, std::vector<std::int64_t>& out);
+    bool query(Relation relation, const std::int32_t* min, const std::int32_t* max, std::vector<std::int64_t>& out);
+
+    struct details;
+
+private:
+    /// @brief Clear the last error; false if the table never opened.
+    bool start();
+
+    details* me;
+    int errcode{0};
+    std::string errmsg;
+};
+
+} // namespace spatial_details
+
+/// @brief A sqlite R*Tree of dims-dimensional boxes keyed by rowid.
+///
+/// @note Coordinate double uses the rtree module, which stores 32-bit
+///       floats rounded outwards, so queries may return boxes that only
+///       touch the query box after rounding. within() widens its box by
+///       the same rounding so that no box inside it is missed, and may
+///       return boxes up to a float step outside. std::int32_t uses
+///       rtree_i32 and is exact. Needs sqlite built with
+///       SQLITE_ENABLE_RTREE. Uses db's connection, so it has db's
+///       threading rules.
+template<std::size_t dims, typename Coordinate = double>
+class SpatialIndex final {
+    static_assert(dims >= 1 && dims <= 5, "sqlite's R*Tree has 1 to 5 dimensions");
+    static_assert(std::is_same<Coordinate, double>::value || std::is_same<Coordinate, std::int32_t>::value,
+                  "coordinates are double (rtree) or std::int32_t (rtree_i32)");
+
+public:
+    struct Box {
+        Coordinate min[dims];
+        Coordinate max[dims];
+    };
+
+    struct Entry {
+        std::int64_t rowid;
+        Box box;
+    };
+
+    /// @brief Use table, creating it if it does not exist.
+    ///
+    /// @note Columns are id, min0, max0, min1, max1, ...
+    SpatialIndex(Database& db, const std::string& table)
+        : index(db, table, dims, std::is_same<Coordinate, std::int32_t>::value) {}
+
+    bool error() const { return index.error(); }
+    int error_code() const { return index.error_code(); }
+    const std::string& error_msg() const { return index.error_msg(); }
+
+    /// @brief Add or replace entries.
+    ///
+    /// @note Runs as one transaction unless one is already open, and is all
+    ///       or nothing in that case.
+    ///
+    /// @returns the entries stored.
+    std::size_t insert(const std::vector<Entry>& entries)
+    {
+        bool opened = index.begin();
+        std::size_t inserted = 0;
+        for (const auto& entry : entries)
+        {
+            if (!index.insert(entry.rowid, entry.box.min, entry.box.max))
+                break;
+            inserted++;
+        }
+        return index.end(opened, inserted);
+    }
+
+    bool remove(std::int64_t rowid) { return index.remove(rowid); }
+
+    /// @brief Rowids of boxes overlapping box, edges included.
+    std::vector<std::int64_t> intersecting(const Box& box) { return query(spatial_details::Relation::intersecting, box); }
+
+    /// @brief Rowids of boxes inside box.
+    ///
+    /// @note For double coordinates, boxes within a float step of box's
+    ///       edges count as inside.
+    std::vector<std::int64_t> within(const Box& box) { return query(spatial_details::Relation::within, box); }
+
+    /// @brief Rowids of boxes that contain box, e.g. a point given as a
+    ///        box with min == max.
+    std::vector<std::int64_t> containing(const Box& box) { return query(spatial_details::Relation::containing, box); }
+
+private:
+    std::vector<std::int64_t> query(spatial_details::Relation relation, const Box& box)
+    {
+        std::vector<std::int64_t> rowids;
+        index.query(relation, box.min, box.max, rowids);
+        return rowids;
+    }
+
+    spatial_details::Index index;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_RTREE_H
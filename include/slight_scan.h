@@ -0,0 +1,53 @@
+#ifndef SLIGHT_SCAN_H
+#define SLIGHT_SCAN_H
+
+#include "slight_cache.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace slight {
+
+struct ScanOptions {
+    /// @brief Integer column whose range is partitioned, ideally the rowid
+    ///        or the leading column of an index.
+    std::string key = "rowid";
+
+    /// @brief Worker threads (one read-only connection each), 0 for one per
+    ///        hardware thread. Never more than there are partitions.
+    unsigned threads = 0;
+};
+
+struct ScanResult {
+    std::size_t partitions = 0;
+    int error_code = 0;
+    std::string error_msg;
+
+    bool error() const { return error_code != 0; }
+};
+
+/// @brief Called once per finished partition with its rows.
+///
+/// @note Calls are serialized, but arrive from worker threads in completion
+///       order, not partition order.
+typedef std::function<void(std::size_t partition, const ResultSet& rows)> ScanCombiner;
+
+/// @brief Run sql_template over table split into partitions key ranges.
+///
+/// @note sql_template binds the inclusive bounds of its range as :lo and
+///       :hi, e.g. "SELECT sum(x) FROM t WHERE rowid BETWEEN :lo AND :hi".
+///       min(key)..max(key) of table is cut into equal-width ranges, so
+///       partitions are balanced only when keys are roughly dense.
+/// @note Workers stop picking up partitions after the first error.
+ScanResult parallel_scan(
+        const std::string& db_path,
+        const std::string& table,
+        const std::string& sql_template,
+        std::size_t partitions,
+        const ScanCombiner& combine,
+        const ScanOptions& options = ScanOptions());
+
+} // namespace slight
+
+#endif // SLIGHT_SCAN_H
@@ -0,0 +1,61 @@
+#ifndef SLIGHT_SESSION_H
+#define SLIGHT_SESSION_H
+
+#include "slight.h"
+
+#include <string>
+
+struct sqlite3_session;
+
+namespace slight {
+
+/// @brief A change Database::apply_changeset() could not apply cleanly.
+struct Conflict {
+    enum class Type {
+        data,        // the row exists but its old values differ
+        not_found,   // the row to update or delete does not exist
+        conflict,    // an inserted row's primary key already exists
+        constraint,  // the change violates another constraint
+        foreign_key, // foreign key violations remain at the end
+    };
+
+    Type type;
+    ChangeOp op;
+    std::string table;
+};
+
+/// @brief Records changes to attached tables through sqlite3session.
+///
+/// @note changeset() holds every change with full old values, patchset()
+///       only what is needed to replay it, which is smaller but cannot
+///       detect data conflicts. Both can be taken repeatedly; recording
+///       continues until the session is released.
+class Session final {
+public:
+    ~Session();
+
+    bool error() const { return errcode != 0; }
+    int error_code() const { return errcode; }
+    const std::string& error_msg() const { return errmsg; }
+
+    /// @brief Also record changes to table.
+    bool attach(const std::string& table);
+
+    /// @brief No changes recorded so far.
+    bool empty() const;
+
+    Changeset changeset();
+    Changeset patchset();
+
+private:
+    friend Database;
+    Session() = default;
+
+    sqlite3_session* handle{nullptr};
+    int errcode{0};
+    std::string errmsg;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_SESSION_H
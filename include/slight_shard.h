@@ -0,0 +1,93 @@
+#ifndef SLIGHT_SHARD_H
+#define SLIGHT_SHARD_H
+
+#include "slight.h"
+#include "slight_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace slight {
+
+/// @brief Rows gathered from every shard.
+///
+/// @note rows point into shards, which stay alive as long as this does.
+struct Gathered {
+    std::vector<std::shared_ptr<const ResultSet>> shards;
+    std::vector<ResultSet::Row> rows;
+
+    int error_code = 0;
+    std::string error_msg;
+
+    bool error() const { return error_code != 0; }
+};
+
+/// @brief Order for a k-way merge of per-shard results.
+///
+/// @note Each shard's rows must already be sorted the same way (ORDER BY
+///       in the sql). type is one of i64, flt or text; NULLs sort first.
+struct MergeKey {
+    int column = 1;
+    ColumnType type = i64;
+    bool descending = false;
+};
+
+/// @brief N independent database files with keys hash-partitioned across them.
+///
+/// @note Shard i lives at "<path>.<i>". The key hash is stable across
+///       builds and platforms, so the same N always maps a key to the same
+///       file. Each shard has its own connection and therefore its own
+///       writer lock. A shard's connection must only be used by one thread
+///       at a time; scatter() uses every shard at once.
+class ShardedDatabase final {
+public:
+    static std::unique_ptr<ShardedDatabase> make_read_only(const std::string& path, std::size_t shards);
+    static std::unique_ptr<ShardedDatabase> make_read_write(const std::string& path, std::size_t shards);
+    static std::unique_ptr<ShardedDatabase> make_create_read_write(const std::string& path, std::size_t shards);
+
+    /// @note Without any shards the database is in error (SQLITE_MISUSE)
+    ///       and can't be used.
+    explicit ShardedDatabase(std::vector<std::unique_ptr<Database>> shards);
+
+    std::size_t size() const { return databases.size(); }
+    Database& operator[](std::size_t shard) { return *databases[shard]; }
+
+    /// @brief Indication that every shard opened successfully.
+    bool opened() const;
+
+    /// @brief Set when there are no shards.
+    bool error() const { return errcode != 0; }
+    int error_code() const { return errcode; }
+    const std::string& error_msg() const { return errmsg; }
+
+    /// @brief Shard that owns key, 0 when there are no shards.
+    std::size_t shard_for(int64_t key) const;
+    std::size_t shard_for(const std::string& key) const;
+
+    /// @brief Prepare statement on the shard that owns key.
+    ///
+    /// @returns nullptr when there are no shards.
+    std::shared_ptr<Statement> prepare(int64_t key, const std::string& statement);
+    std::shared_ptr<Statement> prepare(const std::string& key, const std::string& statement);
+
+    /// @brief Run statement on every shard, one thread per shard.
+    ///
+    /// @note Rows are concatenated in shard order, or k-way merged by key.
+    ///       Without shards the result carries error().
+    Gathered scatter(const std::string& statement, std::initializer_list<const Bind> binds = {});
+    Gathered scatter(const std::string& statement, const MergeKey& key, std::initializer_list<const Bind> binds = {});
+
+private:
+    Gathered failed() const; // carrying this error
+
+    std::vector<std::unique_ptr<Database>> databases;
+    int errcode{0};
+    std::string errmsg;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_SHARD_H
@@ -0,0 +1,47 @@
+#ifndef SLIGHT_VEC_H
+#define SLIGHT_VEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace slight {
+
+struct Statement;
+
+/// @brief Similarity kernels over packed float32 embeddings.
+///
+/// @note Every Database registers these as the SQL functions
+///       vec_dot(a, b), vec_cosine(a, b) and vec_l2(a, b), which take two
+///       float32 blobs of equal length and return a double (NULL if either
+///       argument is NULL).
+/// @note Kernels are picked once at startup: AVX2/FMA or SSE on x86, NEON on
+///       ARM, scalar otherwise. Inputs do not need to be aligned.
+namespace vec {
+
+float dot(const float* a, const float* b, std::size_t n);
+float cosine(const float* a, const float* b, std::size_t n);
+float l2(const float* a, const float* b, std::size_t n);
+
+/// @brief Name of the kernel set in use, e.g. "avx2".
+const char* isa();
+
+struct Match {
+    int64_t id;
+    double score;
+};
+
+enum class Order { largest, smallest };
+
+/// @brief Step stmt to completion, keeping the k best rows in a bounded heap.
+///
+/// @note Column 1 is read as the id and column 2 as the score, e.g.
+///       "SELECT rowid, vec_cosine(embedding, ?) FROM docs".
+///
+/// @returns the best matches, best first.
+std::vector<Match> top_k(Statement& stmt, std::size_t k, Order order = Order::largest);
+
+} // namespace vec
+} // namespace slight
+
+#endif // SLIGHT_VEC_H
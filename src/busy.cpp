@@ -0,0 +1,56 @@
+#include "busy.h"
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace slight {
+
+BusyHandler::BusyHandler(sqlite3* db, const BusyPolicy& policy, MetricsRegistry& metrics)
+    : db(db), policy(policy), metrics(metrics), rng(std::random_device()())
+{
+    sqlite3_busy_handler(db, &BusyHandler::callback, this);
+}
+
+BusyHandler::~BusyHandler() { sqlite3_busy_handler(db, nullptr, nullptr); }
+
+bool BusyHandler::wait(int count)
+{
+    using namespace std::chrono;
+
+    auto now = steady_clock::now();
+    if (count == 0)
+    {
+        started = now;
+        gave_up = false;
+        stats.events++;
+    }
+
+    auto elapsed = duration_cast<microseconds>(now - started);
+    auto remaining = duration_cast<microseconds>(policy.timeout) - elapsed;
+    if (remaining.count() <= 0 || (policy.max_retries >= 0 && count >= policy.max_retries))
+    {
+        stats.timeouts++;
+        gave_up = true;
+        return false;
+    }
+
+    double backoff = policy.initial_backoff.count() * std::pow(policy.multiplier, count);
+    auto ceiling = std::min(static_cast<double>(policy.max_backoff.count()), backoff);
+    auto delay = std::uniform_real_distribution<double>(ceiling / 2, ceiling)(rng);
+    auto sleep = std::min(microseconds(static_cast<microseconds::rep>(delay)), remaining);
+
+    std::this_thread::sleep_for(sleep);
+    stats.retries++;
+    metrics.add(MetricsRegistry::busy_waits);
+    stats.waited += duration_cast<microseconds>(steady_clock::now() - now);
+    return true;
+}
+
+int BusyHandler::callback(void* handler, int count)
+{
+    return static_cast<BusyHandler*>(handler)->wait(count) ? 1 : 0;
+}
+
+} // namespace slight
@@ -0,0 +1,38 @@
+#ifndef SLIGHT_BUSY_H
+#define SLIGHT_BUSY_H
+
+#include "slight.h"
+#include "metrics.h"
+
+#include <chrono>
+#include <random>
+
+struct sqlite3;
+
+namespace slight {
+
+/// @brief Backoff state behind sqlite3_busy_handler, owned by Database::details.
+struct BusyHandler {
+    BusyHandler(sqlite3* db, const BusyPolicy& policy, MetricsRegistry& metrics);
+    ~BusyHandler();
+
+    /// @brief Sleep before retry number count of the current lock event.
+    ///
+    /// @returns false once the policy says to give up.
+    bool wait(int count);
+
+    static int callback(void* handler, int count);
+
+    sqlite3* db;
+    const BusyPolicy policy;
+    MetricsRegistry& metrics;
+    BusyStats stats;
+
+    std::chrono::steady_clock::time_point started;
+    std::minstd_rand rng;
+    bool gave_up = false;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_BUSY_H
@@ -0,0 +1,221 @@
+#include "cache.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <cctype>  // isspace
+#include <cstring> // memcpy, strlen
+
+namespace slight {
+
+namespace {
+
+/// @brief Collapse whitespace runs outside quotes and trim, so formatting
+///        differences don't split cache entries.
+std::string normalize(const std::string& sql)
+{
+    std::string out;
+    out.reserve(sql.size());
+    bool space = false;
+    for (std::size_t i = 0; i < sql.size(); i++)
+    {
+        char c = sql[i];
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            space = !out.empty();
+            continue;
+        }
+        if (space)
+        {
+            out += ' ';
+            space = false;
+        }
+
+        // literals, quoted names and comments are kept as they are; the
+        // newline ending a -- comment is part of it
+        char next = i + 1 < sql.size() ? sql[i + 1] : 0;
+        const char* close = c == '\'' ? "'" : c == '"' ? "\"" : c == '`' ? "`" : c == '[' ? "]"
+                : c == '-' && next == '-' ? "\n" : c == '/' && next == '*' ? "*/" : nullptr;
+        if (!close)
+        {
+            out += c;
+            continue;
+        }
+        std::size_t end = sql.find(close, i + (close[0] == '\n' || close[0] == '*' ? 2 : 1));
+        end = end == std::string::npos ? sql.size() : end + std::strlen(close);
+        out.append(sql, i, end - i);
+        i = end - 1;
+    }
+    return out;
+}
+
+template<typename T>
+void append(std::string& key, const T& value)
+{
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append(std::string& key, const char* str)
+{
+    if (!str)
+        return key.push_back('\0');
+    auto size = std::strlen(str);
+    append(key, size);
+    key.append(str, size);
+}
+
+} // namespace
+
+ResultCache::ResultCache(sqlite3* db, std::size_t max_bytes)
+    : db(db), max_bytes(max_bytes)
+{
+    sqlite3_prepare_v3(db, "PRAGMA data_version", -1, SQLITE_PREPARE_PERSISTENT, &data_version, nullptr);
+}
+
+ResultCache::~ResultCache() { sqlite3_finalize(data_version); }
+
+void ResultCache::validate()
+{
+    int64_t version = -1;
+    if (data_version && sqlite3_step(data_version) == SQLITE_ROW)
+        version = sqlite3_column_int64(data_version, 0);
+    sqlite3_reset(data_version);
+    int64_t changes = sqlite3_total_changes(db);
+
+    if (version != last_data_version || changes != last_total_changes)
+    {
+        stats.invalidations += entries.size();
+        entries.clear();
+        lru.clear();
+        stats.entries = 0;
+        stats.bytes = 0;
+        last_data_version = version;
+        last_total_changes = changes;
+    }
+}
+
+std::shared_ptr<const ResultSet> ResultCache::find(const std::string& key)
+{
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        stats.misses++;
+        return nullptr;
+    }
+
+    stats.hits++;
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+void ResultCache::insert(const std::string& key, std::shared_ptr<const ResultSet> result)
+{
+    auto size = result->bytes() + key.size();
+    if (size > max_bytes)
+        return;
+
+    lru.emplace_front(key, std::move(result));
+    entries[key] = lru.begin();
+    stats.entries++;
+    stats.bytes += size;
+
+    while (stats.bytes > max_bytes)
+    {
+        const auto& victim = lru.back();
+        stats.bytes -= victim.second->bytes() + victim.first.size();
+        stats.entries--;
+        stats.evictions++;
+        entries.erase(victim.first);
+        lru.pop_back();
+    }
+}
+
+std::shared_ptr<ResultSet> ResultCache::materialize(sqlite3* db, sqlite3_stmt* stmt, MetricsRegistry* metrics)
+{
+    auto result = std::make_shared<ResultSet>();
+    int columns = sqlite3_column_count(stmt);
+    for (int c = 0; c < columns; c++)
+        result->names.emplace_back(sqlite3_column_name(stmt, c));
+
+    result->rows.n_columns = columns;
+    int rc;
+    uint64_t bytes = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        bytes += result->rows.append(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        result->errcode = rc;
+        result->errmsg = sqlite3_errmsg(db);
+    }
+
+    if (metrics)
+    {
+        metrics->add(MetricsRegistry::steps, result->rows.size() + 1);
+        metrics->add(MetricsRegistry::rows, result->rows.size());
+        metrics->add(MetricsRegistry::bytes_read, bytes);
+        if (result->error())
+            metrics->error(rc);
+    }
+    result->rows.cells.shrink_to_fit();
+    result->rows.arena.shrink_to_fit();
+    return result;
+}
+
+std::string ResultCache::key(const std::string& sql, std::initializer_list<const Bind> binds)
+{
+    std::string key = normalize(sql);
+    key.push_back('\0');
+    for (const auto& b : binds)
+    {
+        append(key, b.type);
+        if (b.type == Bind::Type::index)
+            append(key, b.index);
+        else if (b.type == Bind::Type::column)
+            append(key, b.column);
+
+        append(key, b.data_type);
+        switch (b.data_type) {
+            case Bind::DataType::i32:
+            case Bind::DataType::i64:
+            case Bind::DataType::u32:
+            case Bind::DataType::iso8601:
+                append(key, b.i);
+                break;
+            case Bind::DataType::flt:
+                append(key, b.f);
+                break;
+            case Bind::DataType::str:
+                append(key, b.str);
+                break;
+            case Bind::DataType::i64_array:
+                append(key, b.array.size);
+                key.append(static_cast<const char*>(b.array.data), b.array.size * sizeof(int64_t));
+                break;
+            case Bind::DataType::flt_array:
+                append(key, b.array.size);
+                key.append(static_cast<const char*>(b.array.data), b.array.size * sizeof(double));
+                break;
+            case Bind::DataType::str_array:
+                append(key, b.array.size);
+                for (std::size_t i = 0; i < b.array.size; i++)
+                {
+                    // all of it: carray binds size() bytes, NULs included
+                    const auto& str = static_cast<const std::string*>(b.array.data)[i];
+                    append(key, str.size());
+                    key.append(str.data(), str.size());
+                }
+                break;
+        }
+    }
+    return key;
+}
+
+std::size_t ResultSet::bytes() const
+{
+    std::size_t size = sizeof(*this) + rows.bytes();
+    for (const auto& name : names)
+        size += sizeof(name) + name.capacity();
+    return size;
+}
+
+} // namespace slight
@@ -0,0 +1,53 @@
+#ifndef SLIGHT_RESULT_CACHE_H
+#define SLIGHT_RESULT_CACHE_H
+
+#include "slight.h"
+#include "slight_cache.h"
+#include "metrics.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace slight {
+
+/// @brief LRU cache of materialized results, owned by Database::details.
+struct ResultCache {
+    ResultCache(sqlite3* db, std::size_t max_bytes);
+    ~ResultCache();
+
+    /// @brief Drop everything if the database changed since the last call.
+    void validate();
+
+    std::shared_ptr<const ResultSet> find(const std::string& key);
+    void insert(const std::string& key, std::shared_ptr<const ResultSet> result);
+
+    /// @brief Step stmt to completion into a new ResultSet.
+    static std::shared_ptr<ResultSet> materialize(sqlite3* db, sqlite3_stmt* stmt, MetricsRegistry* metrics = nullptr);
+
+    /// @brief Cache key for sql with binds.
+    static std::string key(const std::string& sql, std::initializer_list<const Bind> binds);
+
+    typedef std::pair<std::string, std::shared_ptr<const ResultSet>> Entry;
+
+    sqlite3* db;
+    sqlite3_stmt* data_version = nullptr;
+    const std::size_t max_bytes;
+
+    int64_t last_data_version = -1;
+    int64_t last_total_changes = -1;
+
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries;
+    ResultCacheStats stats;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_RESULT_CACHE_H
@@ -0,0 +1,172 @@
+#include "carray.h"
+#include "sqlite3.h"
+
+#include <string>
+
+namespace slight {
+namespace carray {
+
+namespace {
+
+const char* const pointer_type = "slight-carray";
+
+enum Column { value, pointer };
+
+struct Descriptor {
+    Bind::DataType type;
+    Bind::Array array;
+};
+
+struct Cursor {
+    sqlite3_vtab_cursor base;
+    const Descriptor* descriptor;
+    sqlite3_int64 row;
+};
+
+int x_connect(sqlite3* db, void*, int, const char* const*, sqlite3_vtab** vtab, char**)
+{
+    int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(value, pointer HIDDEN)");
+    if (rc == SQLITE_OK)
+        *vtab = new sqlite3_vtab();
+    return rc;
+}
+
+int x_disconnect(sqlite3_vtab* vtab)
+{
+    delete vtab;
+    return SQLITE_OK;
+}
+
+int x_best_index(sqlite3_vtab*, sqlite3_index_info* info)
+{
+    for (int i = 0; i < info->nConstraint; i++)
+    {
+        const auto& constraint = info->aConstraint[i];
+        if (constraint.usable &&
+            constraint.iColumn == pointer &&
+            constraint.op == SQLITE_INDEX_CONSTRAINT_EQ)
+        {
+            info->aConstraintUsage[i].argvIndex = 1;
+            info->aConstraintUsage[i].omit = 1;
+            info->estimatedCost = 1;
+            info->estimatedRows = 100;
+            info->idxNum = 1;
+            return SQLITE_OK;
+        }
+    }
+
+    // without a bound array there is nothing to scan
+    info->estimatedCost = 2147483647;
+    info->estimatedRows = 2147483647;
+    info->idxNum = 0;
+    return SQLITE_OK;
+}
+
+int x_open(sqlite3_vtab*, sqlite3_vtab_cursor** cursor)
+{
+    *cursor = &(new Cursor())->base;
+    return SQLITE_OK;
+}
+
+int x_close(sqlite3_vtab_cursor* cursor)
+{
+    delete reinterpret_cast<Cursor*>(cursor);
+    return SQLITE_OK;
+}
+
+int x_filter(sqlite3_vtab_cursor* base, int idx_num, const char*, int, sqlite3_value** argv)
+{
+    auto cursor = reinterpret_cast<Cursor*>(base);
+    cursor->row = 0;
+    cursor->descriptor = idx_num == 1
+        ? static_cast<const Descriptor*>(sqlite3_value_pointer(argv[0], pointer_type))
+        : nullptr;
+    return SQLITE_OK;
+}
+
+int x_next(sqlite3_vtab_cursor* base)
+{
+    reinterpret_cast<Cursor*>(base)->row++;
+    return SQLITE_OK;
+}
+
+int x_eof(sqlite3_vtab_cursor* base)
+{
+    auto cursor = reinterpret_cast<Cursor*>(base);
+    return !cursor->descriptor || cursor->row >= static_cast<sqlite3_int64>(cursor->descriptor->array.size);
+}
+
+int x_column(sqlite3_vtab_cursor* base, sqlite3_context* ctx, int column)
+{
+    auto cursor = reinterpret_cast<Cursor*>(base);
+    if (column != value)
+    {
+        sqlite3_result_null(ctx);
+        return SQLITE_OK;
+    }
+
+    const auto& array = cursor->descriptor->array;
+    switch (cursor->descriptor->type) {
+        case Bind::DataType::i64_array:
+            sqlite3_result_int64(ctx, static_cast<const int64_t*>(array.data)[cursor->row]);
+            break;
+        case Bind::DataType::flt_array:
+            sqlite3_result_double(ctx, static_cast<const double*>(array.data)[cursor->row]);
+            break;
+        case Bind::DataType::str_array:
+        {
+            const auto& str = static_cast<const std::string*>(array.data)[cursor->row];
+            sqlite3_result_text(ctx, str.data(), static_cast<int>(str.size()), SQLITE_STATIC);
+            break;
+        }
+        default:
+            sqlite3_result_null(ctx);
+            break;
+    }
+    return SQLITE_OK;
+}
+
+int x_rowid(sqlite3_vtab_cursor* base, sqlite3_int64* rowid)
+{
+    *rowid = reinterpret_cast<Cursor*>(base)->row + 1;
+    return SQLITE_OK;
+}
+
+void destroy(void* descriptor) { delete static_cast<Descriptor*>(descriptor); }
+
+// xCreate is null which makes this an eponymous-only module: `carray` can be
+// used directly in FROM / IN without a CREATE VIRTUAL TABLE.
+// Built from a zeroed module so the fields not listed are null as well.
+sqlite3_module make_module()
+{
+    sqlite3_module m = {};
+    m.xConnect = x_connect;
+    m.xBestIndex = x_best_index;
+    m.xDisconnect = x_disconnect;
+    m.xOpen = x_open;
+    m.xClose = x_close;
+    m.xFilter = x_filter;
+    m.xNext = x_next;
+    m.xEof = x_eof;
+    m.xColumn = x_column;
+    m.xRowid = x_rowid;
+    return m;
+}
+
+const sqlite3_module module = make_module();
+
+} // namespace
+
+int register_module(sqlite3* db)
+{
+    return sqlite3_create_module(db, "carray", &module, nullptr);
+}
+
+int bind(sqlite3_stmt* stmt, int index, const Bind& b)
+{
+    auto descriptor = new Descriptor{b.data_type, b.array};
+    return sqlite3_bind_pointer(stmt, index, descriptor, pointer_type, destroy);
+}
+
+} // namespace carray
+} // namespace slight
@@ -0,0 +1,27 @@
+#ifndef SLIGHT_CARRAY_H
+#define SLIGHT_CARRAY_H
+
+#include "slight.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace slight {
+namespace carray {
+
+/// @brief Register the eponymous `carray` table-valued function on a connection.
+///
+/// @note `carray(?)` yields one row per element of the vector bound to `?`,
+///       with the element in column `value`.
+int register_module(sqlite3* db);
+
+/// @brief Bind an array Bind to a parameter consumed by `carray(?)`.
+///
+/// @note Only a small descriptor is allocated; the vector's storage is
+///       handed to sqlite as-is.
+int bind(sqlite3_stmt* stmt, int index, const Bind& bind);
+
+} // namespace carray
+} // namespace slight
+
+#endif // SLIGHT_CARRAY_H
@@ -0,0 +1,99 @@
+#include "changes.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <cstring> // strcmp
+
+namespace slight {
+
+namespace {
+
+void on_update(void* feed, int op, const char*, const char* table, sqlite3_int64 rowid)
+{
+    static_cast<ChangeFeed*>(feed)->on_update(op, table, rowid);
+}
+
+} // namespace
+
+void ChangeFeed::on_update(int op, const char* table, int64_t rowid)
+{
+    auto change = op == SQLITE_INSERT ? ChangeOp::insert : op == SQLITE_UPDATE ? ChangeOp::update : ChangeOp::remove;
+
+    // statements usually repeat one (table, op), so try the last batch first
+    ChangeBatch* batch = nullptr;
+    for (auto it = pending.rbegin(); it != pending.rend(); ++it)
+    {
+        if (it->op == change && std::strcmp(it->table.c_str(), table) == 0)
+        {
+            batch = &*it;
+            break;
+        }
+    }
+    if (!batch)
+    {
+        pending.push_back(ChangeBatch{table, change, {}});
+        batch = &pending.back();
+    }
+    batch->rowids.push_back(rowid);
+}
+
+void ChangeFeed::on_rollback()
+{
+    pending.clear();
+    committing = false;
+}
+
+std::vector<std::size_t> ChangeFeed::mark() const
+{
+    std::vector<std::size_t> sizes;
+    for (const auto& batch : pending)
+        sizes.push_back(batch.rowids.size());
+    return sizes;
+}
+
+void ChangeFeed::rollback_to(const std::vector<std::size_t>& mark)
+{
+    pending.resize(std::min(pending.size(), mark.size()));
+    for (std::size_t i = 0; i < pending.size(); i++)
+        pending[i].rowids.resize(mark[i]);
+}
+
+void ChangeFeed::deliver(sqlite3* db)
+{
+    committing = false;
+    if (!sqlite3_get_autocommit(db)) // the COMMIT failed and may be retried
+        return;
+    if (pending.empty())
+        return;
+
+    std::vector<ChangeBatch> changes;
+    changes.swap(pending);
+
+    // copy so listeners may subscribe or unsubscribe while being called
+    auto current = listeners;
+    for (const auto& listener : current)
+        listener.second(changes);
+}
+
+std::size_t Database::subscribe_changes(ChangeListener listener)
+{
+    if (!me->changes.subscribed())
+        sqlite3_update_hook(me->db, &on_update, &me->changes);
+
+    auto id = me->changes.next_id++;
+    me->changes.listeners[id] = std::move(listener);
+    return id;
+}
+
+void Database::unsubscribe_changes(std::size_t id)
+{
+    me->changes.listeners.erase(id);
+    if (!me->changes.subscribed())
+    {
+        sqlite3_update_hook(me->db, nullptr, nullptr);
+        me->changes.pending.clear();
+    }
+}
+
+} // namespace slight
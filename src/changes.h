@@ -0,0 +1,50 @@
+#ifndef SLIGHT_CHANGES_H
+#define SLIGHT_CHANGES_H
+
+#include "slight.h"
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+struct sqlite3;
+
+namespace slight {
+
+/// @brief Row changes of the open transaction, handed to subscribers once
+///        it has committed.
+///
+/// @note sqlite's commit hook runs before the commit is final, so it only
+///       marks the buffer; after_commit() delivers it once the connection
+///       is back in autocommit mode. Every place that can finish a COMMIT
+///       calls after_commit() when its step or exec returns.
+struct ChangeFeed {
+    bool subscribed() const { return !listeners.empty(); }
+
+    void on_update(int op, const char* table, int64_t rowid);
+    void on_commit() { committing = true; }
+    void on_rollback();
+
+    void after_commit(sqlite3* db)
+    {
+        if (committing)
+            deliver(db);
+    }
+
+    void deliver(sqlite3* db);
+
+    /// @brief Position to cut pending back to when a savepoint we opened
+    ///        is rolled back; sqlite has no hook for ROLLBACK TO.
+    std::vector<std::size_t> mark() const;
+    void rollback_to(const std::vector<std::size_t>& mark);
+
+    std::map<std::size_t, ChangeListener> listeners;
+    std::size_t next_id{1};
+
+    std::vector<ChangeBatch> pending;
+    bool committing{false};
+};
+
+} // namespace slight
+
+#endif // SLIGHT_CHANGES_H
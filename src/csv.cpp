@@ -0,0 +1,639 @@
+#include "slight_csv.h"
+#include "details.h"
+#include "slight.h"
+#include "sqlite3.h"
+
+#include <algorithm>          // min, max
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>            // strtod
+#include <cstring>            // memchr, strerror
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace slight {
+
+namespace {
+
+/// @brief A field converted by a parser thread, ready to be bound.
+struct Cell {
+    enum Type : uint8_t { null, integer, real, text } type;
+    uint32_t size;
+    union {
+        int64_t i;
+        double f;
+        const char* str;
+    };
+};
+
+/// @brief Rows handed from a parser to the writer.
+///
+/// @note Text cells point into the mapped file, or into unescaped for
+///       quoted fields containing doubled quotes. A deque never moves its
+///       elements, so those pointers stay valid as it grows.
+struct Batch {
+    std::vector<Cell> cells;
+    std::deque<std::string> unescaped;
+    std::size_t rows = 0;
+};
+
+/// @brief Read-only mapping of the input file.
+struct Mapping {
+    explicit Mapping(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            error_msg = path + ": " + std::strerror(errno);
+            return;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            size = static_cast<std::size_t>(st.st_size);
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+                error_msg = path + ": " + std::strerror(errno);
+            else
+            {
+                data = static_cast<const char*>(p);
+                ::madvise(p, size, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+    }
+    ~Mapping()
+    {
+        if (data)
+            ::munmap(const_cast<char*>(data), size);
+    }
+
+    const char* data = nullptr;
+    std::size_t size = 0;
+    std::string error_msg;
+};
+
+/// @brief Parses records from [p, end) one field at a time.
+struct Parser {
+    Parser(const CsvOptions& options, const char* p, const char* end)
+        : options(options), p(p), end(end) {}
+
+    bool done() const { return p >= end; }
+
+    /// @brief Parse one field. Returns false after the last field of a record.
+    bool field(Cell& cell, Batch& batch)
+    {
+        if (p < end && *p == options.quote)
+            quoted(cell, batch);
+        else
+            unquoted(cell);
+
+        if (p < end && *p == options.delimiter)
+        {
+            p++;
+            return true;
+        }
+
+        // end of record
+        if (p < end && *p == '\r')
+            p++;
+        if (p < end && *p == '\n')
+            p++;
+        return false;
+    }
+
+    void unquoted(Cell& cell)
+    {
+        const char* start = p;
+        while (p < end && *p != options.delimiter && *p != '\n')
+            p++;
+        const char* stop = p;
+        if (stop > start && stop[-1] == '\r')
+            stop--;
+        convert(cell, start, static_cast<std::size_t>(stop - start));
+    }
+
+    void quoted(Cell& cell, Batch& batch)
+    {
+        const char* start = ++p;
+        bool escaped = false;
+        while (p < end)
+        {
+            if (*p == options.quote)
+            {
+                if (p + 1 < end && p[1] == options.quote)
+                {
+                    escaped = true;
+                    p += 2;
+                    continue;
+                }
+                break;
+            }
+            p++;
+        }
+        const char* stop = p;
+        if (p < end)
+            p++; // closing quote
+
+        // anything between the closing quote and the next separator is skipped
+        while (p < end && *p != options.delimiter && *p != '\n' && *p != '\r')
+            p++;
+
+        cell.type = Cell::text;
+        if (!escaped)
+        {
+            cell.str = start;
+            cell.size = static_cast<uint32_t>(stop - start);
+            return;
+        }
+
+        batch.unescaped.emplace_back();
+        auto& str = batch.unescaped.back();
+        str.reserve(static_cast<std::size_t>(stop - start));
+        for (const char* c = start; c < stop; c++)
+        {
+            str += *c;
+            if (*c == options.quote)
+                c++;
+        }
+        cell.str = str.data();
+        cell.size = static_cast<uint32_t>(str.size());
+    }
+
+    void convert(Cell& cell, const char* str, std::size_t size)
+    {
+        if (size == 0)
+        {
+            cell.type = Cell::null;
+            return;
+        }
+
+        if (options.convert_types)
+        {
+            if (to_integer(str, size, cell.i))
+            {
+                cell.type = Cell::integer;
+                return;
+            }
+            if (to_real(str, size, cell.f))
+            {
+                cell.type = Cell::real;
+                return;
+            }
+        }
+
+        cell.type = Cell::text;
+        cell.str = str;
+        cell.size = static_cast<uint32_t>(size);
+    }
+
+    static bool to_integer(const char* str, std::size_t size, int64_t& value)
+    {
+        std::size_t i = 0;
+        bool negative = str[0] == '-';
+        if (str[0] == '-' || str[0] == '+')
+            i++;
+        if (i == size || size - i > 19)
+            return false;
+
+        uint64_t v = 0;
+        for (; i < size; i++)
+        {
+            unsigned digit = static_cast<unsigned char>(str[i]) - '0';
+            if (digit > 9)
+                return false;
+            v = v * 10 + digit;
+        }
+
+        uint64_t limit = negative ? uint64_t(1) << 63 : (uint64_t(1) << 63) - 1;
+        if (v > limit)
+            return false;
+        value = negative ? static_cast<int64_t>(0 - v) : static_cast<int64_t>(v);
+        return true;
+    }
+
+    static bool to_real(const char* str, std::size_t size, double& value)
+    {
+        // strtod wants a terminated string; anything longer is not a number we'd keep
+        char buffer[64];
+        if (size >= sizeof(buffer))
+            return false;
+        char c = str[0];
+        if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.'))
+            return false;
+
+        std::memcpy(buffer, str, size);
+        buffer[size] = '\0';
+        char* stop = nullptr;
+        value = std::strtod(buffer, &stop);
+        return stop == buffer + size;
+    }
+
+    const CsvOptions& options;
+    const char* p;
+    const char* end;
+};
+
+/// @brief Bounded multi-producer, single-consumer hand-off of parsed batches.
+struct Queue {
+    explicit Queue(std::size_t capacity) : capacity(capacity) {}
+
+    bool push(Batch&& batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return batches.size() < capacity || cancelled; });
+        if (cancelled)
+            return false;
+        batches.push_back(std::move(batch));
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(Batch& batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return !batches.empty() || producers == 0 || !error_msg.empty(); });
+        if (batches.empty() || !error_msg.empty())
+            return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void producer_done(const std::string& error)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error.empty() && error_msg.empty())
+            error_msg = error;
+        producers--;
+        not_empty.notify_one();
+    }
+
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        not_full.notify_all();
+    }
+
+    const std::size_t capacity;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<Batch> batches;
+    std::size_t producers = 0;
+    bool cancelled = false;
+    std::string error_msg;
+};
+
+/// @brief Parse every record in [begin, end) into batches of complete rows.
+void parse(const CsvOptions& options, std::size_t columns, const char* begin, const char* end, Queue& queue)
+{
+    Parser parser(options, begin, end);
+    Batch batch;
+    batch.cells.reserve(options.batch_rows * columns);
+    std::string error;
+
+    while (!parser.done())
+    {
+        std::size_t first = batch.cells.size();
+        bool more = true;
+        while (more)
+        {
+            batch.cells.emplace_back();
+            more = parser.field(batch.cells.back(), batch);
+        }
+
+        std::size_t fields = batch.cells.size() - first;
+        if (fields == 1 && columns > 1 && batch.cells.back().type == Cell::null)
+        {
+            // blank line; with one column it is a NULL field instead
+            batch.cells.resize(first);
+            continue;
+        }
+        if (fields != columns)
+        {
+            error = "record has " + std::to_string(fields) + " fields, expected " + std::to_string(columns);
+            break;
+        }
+
+        if (++batch.rows == options.batch_rows)
+        {
+            if (!queue.push(std::move(batch)))
+                break;
+            batch = Batch();
+            batch.cells.reserve(options.batch_rows * columns);
+        }
+    }
+
+    if (batch.rows > 0 && error.empty())
+        queue.push(std::move(batch));
+    queue.producer_done(error);
+}
+
+/// @brief Count quotes in [begin, end), for finding record boundaries.
+std::size_t count_quotes(const char* begin, const char* end, char quote)
+{
+    std::size_t count = 0;
+    while ((begin = static_cast<const char*>(std::memchr(begin, quote, static_cast<std::size_t>(end - begin)))))
+    {
+        count++;
+        begin++;
+    }
+    return count;
+}
+
+/// @brief Split [begin, end) into up to n chunks that each start at a record.
+///
+/// @note A newline only ends a record outside quotes. Doubled quotes inside a
+///       quoted field keep the parity even, so the quote count before a byte
+///       tells whether it is inside a quoted field. Counting is done in
+///       parallel per raw slice before the slices are snapped to records.
+std::vector<const char*> split(const char* begin, const char* end, unsigned n, char quote)
+{
+    std::size_t size = static_cast<std::size_t>(end - begin);
+    std::vector<const char*> raw;
+    for (unsigned i = 0; i <= n; i++)
+        raw.push_back(begin + size * i / n);
+
+    std::vector<std::size_t> quotes(n);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < n; i++)
+        threads.emplace_back([&, i] { quotes[i] = count_quotes(raw[i], raw[i + 1], quote); });
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<const char*> bounds{begin};
+    std::size_t parity = 0;
+    for (unsigned i = 1; i < n; i++)
+    {
+        parity += quotes[i - 1];
+        const char* p = raw[i];
+        bool in_quotes = parity % 2 == 1;
+        // raw[i] could be just after a newline already
+        if (!in_quotes && p[-1] == '\n')
+        {
+            bounds.push_back(p);
+            continue;
+        }
+        while (p < end && (in_quotes || *p != '\n'))
+        {
+            if (*p == quote)
+                in_quotes = !in_quotes;
+            p++;
+        }
+        if (p < end)
+            p++;
+        if (p > bounds.back())
+            bounds.push_back(p);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+std::string quote_identifier(const std::string& name)
+{
+    std::string quoted = "\"";
+    for (char c : name)
+    {
+        quoted += c;
+        if (c == '"')
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+std::string insert_sql(const std::string& table, std::size_t columns, std::size_t rows)
+{
+    std::string row = "(";
+    for (std::size_t c = 0; c < columns; c++)
+        row += c ? ",?" : "?";
+    row += ")";
+
+    std::string sql = "INSERT INTO " + quote_identifier(table) + " VALUES ";
+    sql.reserve(sql.size() + rows * (row.size() + 1));
+    for (std::size_t r = 0; r < rows; r++)
+    {
+        if (r)
+            sql += ",";
+        sql += row;
+    }
+    return sql;
+}
+
+int bind(sqlite3_stmt* stmt, int index, const Cell& cell)
+{
+    switch (cell.type) {
+        case Cell::integer:
+            return sqlite3_bind_int64(stmt, index, cell.i);
+        case Cell::real:
+            return sqlite3_bind_double(stmt, index, cell.f);
+        case Cell::text:
+            return sqlite3_bind_text(stmt, index, cell.str, static_cast<int>(cell.size), SQLITE_STATIC);
+        case Cell::null:
+            break;
+    }
+    return sqlite3_bind_null(stmt, index);
+}
+
+/// @brief Single writer: inserts batches through cached multi-row statements.
+struct Writer {
+    Writer(sqlite3* db, const std::string& table, std::size_t columns, std::size_t rows_per_statement)
+        : db(db), columns(columns), rows_per_statement(rows_per_statement)
+    {
+        if (sqlite3_prepare_v3(db, insert_sql(table, columns, rows_per_statement).c_str(), -1,
+                               SQLITE_PREPARE_PERSISTENT, &multi, nullptr) == SQLITE_OK)
+            sqlite3_prepare_v3(db, insert_sql(table, columns, 1).c_str(), -1,
+                               SQLITE_PREPARE_PERSISTENT, &single, nullptr);
+        if (!single)
+            error_msg = sqlite3_errmsg(db);
+    }
+    ~Writer()
+    {
+        sqlite3_finalize(multi);
+        sqlite3_finalize(single);
+    }
+
+    bool exec(const char* sql)
+    {
+        if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            error_msg = sqlite3_errmsg(db);
+            return false;
+        }
+        return true;
+    }
+
+    bool insert(sqlite3_stmt* stmt, const Cell* cells, std::size_t rows)
+    {
+        int index = 1;
+        for (std::size_t i = 0; i < rows * columns; i++)
+            bind(stmt, index++, cells[i]);
+
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            error_msg = sqlite3_errmsg(db);
+            return false;
+        }
+        return true;
+    }
+
+    bool insert(const Batch& batch)
+    {
+        const Cell* cells = batch.cells.data();
+        std::size_t row = 0;
+        for (; row + rows_per_statement <= batch.rows; row += rows_per_statement)
+            if (!insert(multi, cells + row * columns, rows_per_statement))
+                return false;
+        for (; row < batch.rows; row++)
+            if (!insert(single, cells + row * columns, 1))
+                return false;
+        return true;
+    }
+
+    sqlite3* db;
+    const std::size_t columns;
+    const std::size_t rows_per_statement;
+    sqlite3_stmt* multi = nullptr;
+    sqlite3_stmt* single = nullptr;
+    std::string error_msg;
+};
+
+} // namespace
+
+CsvResult load_csv(Database& db, const std::string& table, const std::string& path, const CsvOptions& options)
+{
+    CsvResult result;
+
+    Mapping file(path);
+    if (!file.error_msg.empty())
+    {
+        result.error_msg = file.error_msg;
+        return result;
+    }
+
+    const char* begin = file.data;
+    const char* end = file.data + file.size;
+    if (begin == end)
+        return result;
+
+    // the first record decides the number of columns
+    std::vector<std::string> names;
+    {
+        CsvOptions text_only = options;
+        text_only.convert_types = false;
+        Parser parser(text_only, begin, end);
+        Batch batch;
+        Cell cell;
+        bool more = true;
+        while (more)
+        {
+            more = parser.field(cell, batch);
+            names.push_back(cell.type == Cell::text ? std::string(cell.str, cell.size) : std::string());
+        }
+        if (options.header)
+            begin = parser.p;
+    }
+    if (begin == end)
+        return result;
+    const std::size_t columns = names.size();
+
+    if (options.create_table)
+    {
+        std::string create = "CREATE TABLE IF NOT EXISTS " + quote_identifier(table) + "(";
+        for (std::size_t c = 0; c < columns; c++)
+        {
+            std::string name = options.header && !names[c].empty() ? names[c] : "c" + std::to_string(c + 1);
+            create += (c ? ", " : "") + quote_identifier(name);
+        }
+        create += ")";
+        if (sqlite3_exec(db.handle(), create.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            result.error_msg = sqlite3_errmsg(db.handle());
+            return result;
+        }
+    }
+
+    std::size_t variables = static_cast<std::size_t>(sqlite3_limit(db.handle(), SQLITE_LIMIT_VARIABLE_NUMBER, -1));
+    std::size_t rows_per_statement = std::max<std::size_t>(1, variables / columns);
+    rows_per_statement = std::min<std::size_t>(rows_per_statement, options.rows_per_statement ? options.rows_per_statement : 128);
+
+    Writer writer(db.handle(), table, columns, rows_per_statement);
+    if (!writer.error_msg.empty())
+    {
+        result.error_msg = writer.error_msg;
+        return result;
+    }
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    if (static_cast<std::size_t>(end - begin) < (std::size_t(1) << 20))
+        threads = 1;
+
+    CsvOptions parse_options = options;
+    parse_options.batch_rows = std::max<std::size_t>(1, options.batch_rows);
+
+    auto bounds = split(begin, end, threads, options.quote);
+    Queue queue(2 * (bounds.size() - 1));
+    queue.producers = bounds.size() - 1;
+
+    std::vector<std::thread> parsers;
+    for (std::size_t i = 0; i + 1 < bounds.size(); i++)
+        parsers.emplace_back(parse, std::cref(parse_options), columns, bounds[i], bounds[i + 1], std::ref(queue));
+
+    std::size_t in_transaction = 0;
+    bool ok = writer.exec("BEGIN");
+    Batch batch;
+    while (ok && queue.pop(batch))
+    {
+        ok = writer.insert(batch);
+        if (!ok)
+            break;
+
+        result.rows += batch.rows;
+        in_transaction += batch.rows;
+        if (in_transaction >= options.transaction_rows)
+        {
+            // a failed COMMIT (e.g. SQLITE_BUSY) leaves these rows to the ROLLBACK
+            ok = writer.exec("COMMIT");
+            Database::details::of(db).changes.after_commit(db.handle());
+            if (!ok)
+                break;
+            in_transaction = 0;
+            ok = writer.exec("BEGIN");
+        }
+    }
+
+    // releases parsers still waiting on a full queue after an error
+    queue.cancel();
+    for (auto& parser : parsers)
+        parser.join();
+
+    if (ok && queue.error_msg.empty())
+    {
+        ok = writer.exec("COMMIT");
+        Database::details::of(db).changes.after_commit(db.handle());
+    }
+    if (!ok || !queue.error_msg.empty())
+    {
+        result.error_msg = !writer.error_msg.empty() ? writer.error_msg : queue.error_msg;
+        sqlite3_exec(db.handle(), "ROLLBACK", nullptr, nullptr, nullptr);
+        Database::details::of(db).changes.after_commit(db.handle());
+        result.rows -= in_transaction;
+    }
+
+    return result;
+}
+
+} // namespace slight
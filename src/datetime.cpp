@@ -0,0 +1,203 @@
+#include "slight.h"
+
+#include <cstring> // memcpy
+
+namespace slight {
+
+namespace {
+
+const uint64_t ones = 0x0101010101010101ull;
+
+// little-endian regardless of the host, which compilers fold to one load
+uint64_t load8(const char* p)
+{
+    uint64_t word = 0;
+    for (int i = 0; i < 8; i++)
+        word |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return word;
+}
+
+// every byte outside mask is '0'-'9'; bytes under mask equal those of expected
+bool matches(uint64_t word, uint64_t mask, uint64_t expected)
+{
+    uint64_t digits = (word & ~mask) | (ones * '0' & mask);
+    bool all_digits = ((digits & ones * 0xf0) | (((digits + ones * 0x06) & ones * 0xf0) >> 4)) == ones * 0x33;
+    return all_digits && (word & mask) == expected;
+}
+
+int digit(uint64_t word, int byte) { return static_cast<int>((word >> (8 * byte)) & 0x0f); }
+int pair(uint64_t word, int byte) { return digit(word, byte) * 10 + digit(word, byte + 1); }
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// days since 1970-01-01 in the proleptic Gregorian calendar, and back
+// (http://howardhinnant.github.io/date_algorithms.html)
+int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void civil_from_days(int64_t z, int64_t& y, unsigned& m, unsigned& d)
+{
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+unsigned days_in_month(int64_t y, unsigned m)
+{
+    static const unsigned char days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+    return m == 2 && leap ? 29 : days[m - 1];
+}
+
+void put2(char* out, unsigned value)
+{
+    out[0] = static_cast<char>('0' + value / 10);
+    out[1] = static_cast<char>('0' + value % 10);
+}
+
+} // namespace
+
+bool parse_iso8601(const char* text, std::size_t size, DateTime& out)
+{
+    if (!text || size < 10)
+        return false;
+
+    // short inputs are copied so both words can always be loaded
+    char padded[16] = {};
+    const char* s = text;
+    if (size < 16)
+    {
+        std::memcpy(padded, text, size);
+        s = padded;
+    }
+
+    // "YYYY-MM-" and "DDTHH:MM", masks covering the separator bytes
+    const uint64_t date_mask = 0xff0000ff00000000ull;
+    const uint64_t date_seps = 0x2d00002d00000000ull; // '-'
+    const uint64_t time_mask = 0x0000ff0000ff0000ull; // the 'T' is checked apart
+    const uint64_t time_seps = 0x00003a0000000000ull; // ':'
+
+    uint64_t date = load8(s);
+    uint64_t rest = load8(s + 8);
+    if (!matches(date, date_mask, date_seps) || !is_digit(s[8]) || !is_digit(s[9]))
+        return false;
+
+    int64_t year = pair(date, 0) * 100 + pair(date, 2);
+    unsigned month = static_cast<unsigned>(pair(date, 5));
+    unsigned day = static_cast<unsigned>(pair(rest, 0));
+    if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month))
+        return false;
+
+    int64_t seconds = days_from_civil(year, month, day) * 86400;
+    int64_t micros = 0;
+    std::size_t at = 10;
+
+    if (size > 10)
+    {
+        char t = s[10];
+        if (size < 19 || (t != 'T' && t != 't' && t != ' '))
+            return false;
+        if (!matches(rest & ~(0xffull << 16), time_mask, time_seps) || s[16] != ':' || !is_digit(s[17])
+            || !is_digit(s[18]))
+            return false;
+
+        int hour = pair(rest, 3);
+        int minute = pair(rest, 6);
+        int second = (s[17] - '0') * 10 + (s[18] - '0');
+        if (hour > 23 || minute > 59 || second > 59)
+            return false;
+        seconds += hour * 3600 + minute * 60 + second;
+        at = 19;
+
+        if (at < size && text[at] == '.')
+        {
+            int scale = 100000;
+            std::size_t first = ++at;
+            for (; at < size && is_digit(text[at]); at++, scale /= 10)
+                micros += (text[at] - '0') * scale;
+            if (at == first)
+                return false;
+        }
+
+        if (at < size && (text[at] == 'Z' || text[at] == 'z'))
+        {
+            at++;
+        }
+        else if (at < size && (text[at] == '+' || text[at] == '-'))
+        {
+            int sign = text[at++] == '-' ? -1 : 1;
+            if (size - at < 2 || !is_digit(text[at]) || !is_digit(text[at + 1]))
+                return false;
+            int offset = ((text[at] - '0') * 10 + (text[at + 1] - '0')) * 60;
+            at += 2;
+            std::size_t minutes = at < size && text[at] == ':' ? at + 1 : at;
+            if (minutes + 2 <= size && is_digit(text[minutes]) && is_digit(text[minutes + 1]))
+            {
+                offset += (text[minutes] - '0') * 10 + (text[minutes + 1] - '0');
+                at = minutes + 2;
+            }
+            seconds -= sign * offset * 60;
+        }
+    }
+
+    if (at != size)
+        return false;
+    out = DateTime(std::chrono::microseconds(seconds * 1000000 + micros));
+    return true;
+}
+
+std::size_t format_iso8601(DateTime value, char* out)
+{
+    int64_t micros = value.time_since_epoch().count();
+    int64_t seconds = micros / 1000000;
+    micros %= 1000000;
+    if (micros < 0)
+    {
+        micros += 1000000;
+        seconds--;
+    }
+    int64_t days = seconds / 86400;
+    int64_t second = seconds % 86400;
+    if (second < 0)
+    {
+        second += 86400;
+        days--;
+    }
+
+    int64_t year;
+    unsigned month, day;
+    civil_from_days(days, year, month, day);
+
+    put2(out, static_cast<unsigned>(year / 100));
+    put2(out + 2, static_cast<unsigned>(year % 100));
+    out[4] = '-';
+    put2(out + 5, month);
+    out[7] = '-';
+    put2(out + 8, day);
+    out[10] = 'T';
+    put2(out + 11, static_cast<unsigned>(second / 3600));
+    out[13] = ':';
+    put2(out + 14, static_cast<unsigned>(second / 60 % 60));
+    out[16] = ':';
+    put2(out + 17, static_cast<unsigned>(second % 60));
+    out[19] = '.';
+    for (int i = 25; i > 19; i--, micros /= 10)
+        out[i] = static_cast<char>('0' + micros % 10);
+    out[26] = 'Z';
+    return iso8601_size;
+}
+
+} // namespace slight
@@ -0,0 +1,61 @@
+#ifndef SLIGHT_DETAILS_H
+#define SLIGHT_DETAILS_H
+
+#include "slight.h"
+#include "changes.h"
+#include "metrics.h"
+#include "sqlite3.h"
+
+#include <memory>
+#include <string>
+
+namespace slight {
+
+/// @brief Statement
+///
+/// @note This class is used to access the results of a database operation.
+///
+struct Statement::details {
+    details(sqlite3* db, std::string statement)
+        : statement(std::move(statement))
+        , sqlite_errcode(sqlite3_errcode(db))
+        , db(db)
+        , stmt() {}
+    ~details() { sqlite3_finalize(stmt); }
+
+    const std::string statement;
+
+    int sqlite_errcode;
+    std::string sqlite_errmsg;
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+    Database::details* database{nullptr};
+    uint64_t bytes_read{0}; // by get<>, flushed to metrics on step()
+};
+
+struct BusyHandler;
+struct ResultCache;
+
+struct Database::details {
+    details(const std::string& path, int access);
+    ~details();
+
+    sqlite3* db{nullptr};
+    struct {
+        bool opened{false};
+        std::string path;
+        std::string error_msg;
+    } status;
+
+    /// @brief The internals of db, for subsystems outside slight.cpp.
+    static details& of(Database& db) { return *db.me; }
+
+    MetricsRegistry metrics;
+    ChangeFeed changes;
+    std::unique_ptr<BusyHandler> busy;
+    std::unique_ptr<ResultCache> cache;
+};
+
+} // namespace slight
+
+#endif // SLIGHT_DETAILS_H
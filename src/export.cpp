@@ -0,0 +1,506 @@
+#include "slight.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <cerrno>
+#include <cmath>   // isfinite, trunc, fabs
+#include <cstdio>  // snprintf
+#include <cstdlib> // strtod
+#include <cstring> // memcpy, strerror
+#include <ostream>
+
+#include <unistd.h>
+
+namespace slight {
+
+namespace {
+
+struct Sink {
+    virtual ~Sink() = default;
+    virtual bool write(const char* data, std::size_t size) = 0;
+    virtual std::string error_msg() const = 0;
+};
+
+struct FdSink final : Sink {
+    explicit FdSink(int fd) : fd(fd) {}
+
+    bool write(const char* data, std::size_t size) override
+    {
+        while (size > 0)
+        {
+            auto n = ::write(fd, data, size);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                error = errno;
+                return false;
+            }
+            data += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+    std::string error_msg() const override { return std::strerror(error); }
+
+    int fd;
+    int error = 0;
+};
+
+struct StreamSink final : Sink {
+    explicit StreamSink(std::ostream& out) : out(out) {}
+
+    bool write(const char* data, std::size_t size) override
+    {
+        out.write(data, static_cast<std::streamsize>(size));
+        return static_cast<bool>(out);
+    }
+    std::string error_msg() const override { return "stream write failed"; }
+
+    std::ostream& out;
+};
+
+/// @brief Fixed output buffer flushed to a sink whenever it fills up.
+class Buffer {
+public:
+    explicit Buffer(Sink& sink) : sink(sink) {}
+
+    bool ok() const { return !failed; }
+
+    /// @brief Room for at least n more bytes, flushing first if needed.
+    char* reserve(std::size_t n)
+    {
+        if (used + n > sizeof(data))
+            flush();
+        return data + used;
+    }
+    void commit(std::size_t n) { used += n; }
+
+    void put(char c)
+    {
+        *reserve(1) = c;
+        used++;
+    }
+
+    void append(const char* str, std::size_t size)
+    {
+        if (size > sizeof(data) / 2)
+        {
+            flush();
+            if (!failed && !sink.write(str, size))
+                failed = true;
+            return;
+        }
+        std::memcpy(reserve(size), str, size);
+        used += size;
+    }
+
+    void flush()
+    {
+        if (used > 0 && !failed && !sink.write(data, used))
+            failed = true;
+        used = 0;
+    }
+
+private:
+    Sink& sink;
+    char data[1 << 16];
+    std::size_t used = 0;
+    bool failed = false;
+};
+
+const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/// @brief Decimal digits of value into out (at least 20 bytes), returns the length.
+std::size_t format_u64(char* out, uint64_t value)
+{
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    while (value >= 100)
+    {
+        auto pair = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10)
+    {
+        auto pair = static_cast<unsigned>(value) * 2;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    else
+        *--p = static_cast<char>('0' + value);
+
+    auto size = static_cast<std::size_t>(tmp + sizeof(tmp) - p);
+    std::memcpy(out, p, size);
+    return size;
+}
+
+void write_i64(Buffer& buffer, int64_t value)
+{
+    char* out = buffer.reserve(21);
+    std::size_t size = 0;
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0)
+    {
+        out[size++] = '-';
+        magnitude = 0 - magnitude;
+    }
+    size += format_u64(out + size, magnitude);
+    buffer.commit(size);
+}
+
+/// @brief Shortest of %.15g / %.17g that reads back as the same double.
+void write_flt(Buffer& buffer, double value)
+{
+    char* out = buffer.reserve(32);
+    if (std::trunc(value) == value && std::fabs(value) < 1e15)
+    {
+        std::size_t size = 0;
+        auto i = static_cast<int64_t>(value);
+        if (i < 0 || (i == 0 && std::signbit(value)))
+            out[size++] = '-';
+        size += format_u64(out + size, static_cast<uint64_t>(i < 0 ? -i : i));
+        out[size++] = '.';
+        out[size++] = '0';
+        buffer.commit(size);
+        return;
+    }
+
+    int size = std::snprintf(out, 32, "%.15g", value);
+    if (std::strtod(out, nullptr) != value)
+        size = std::snprintf(out, 32, "%.17g", value);
+    buffer.commit(static_cast<std::size_t>(size));
+}
+
+void write_hex(Buffer& buffer, const unsigned char* data, std::size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (std::size_t i = 0; i < size; i++)
+    {
+        char* out = buffer.reserve(2);
+        out[0] = digits[data[i] >> 4];
+        out[1] = digits[data[i] & 0xf];
+        buffer.commit(2);
+    }
+}
+
+void write_varint(Buffer& buffer, uint64_t value)
+{
+    char* out = buffer.reserve(10);
+    std::size_t size = 0;
+    while (value >= 0x80)
+    {
+        out[size++] = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out[size++] = static_cast<char>(value);
+    buffer.commit(size);
+}
+
+void write_csv_text(Buffer& buffer, const char* str, std::size_t size)
+{
+    bool quote = false;
+    for (std::size_t i = 0; i < size && !quote; i++)
+        quote = str[i] == ',' || str[i] == '"' || str[i] == '\n' || str[i] == '\r';
+
+    if (!quote)
+        return buffer.append(str, size);
+
+    buffer.put('"');
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        if (str[i] == '"')
+        {
+            buffer.append(str + run, i + 1 - run);
+            buffer.put('"');
+            run = i + 1;
+        }
+    }
+    buffer.append(str + run, size - run);
+    buffer.put('"');
+}
+
+void write_json_text(Buffer& buffer, const char* str, std::size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    buffer.put('"');
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        auto c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        buffer.append(str + run, i - run);
+        run = i + 1;
+        char* out = buffer.reserve(6);
+        switch (c) {
+            case '"':  out[0] = '\\'; out[1] = '"';  buffer.commit(2); break;
+            case '\\': out[0] = '\\'; out[1] = '\\'; buffer.commit(2); break;
+            case '\n': out[0] = '\\'; out[1] = 'n';  buffer.commit(2); break;
+            case '\r': out[0] = '\\'; out[1] = 'r';  buffer.commit(2); break;
+            case '\t': out[0] = '\\'; out[1] = 't';  buffer.commit(2); break;
+            default:
+                std::memcpy(out, "\\u00", 4);
+                out[4] = digits[c >> 4];
+                out[5] = digits[c & 0xf];
+                buffer.commit(6);
+                break;
+        }
+    }
+    buffer.append(str + run, size - run);
+    buffer.put('"');
+}
+
+const char* text(sqlite3_stmt* stmt, int column) { return reinterpret_cast<const char*>(sqlite3_column_text(stmt, column)); }
+std::size_t bytes(sqlite3_stmt* stmt, int column) { return static_cast<std::size_t>(sqlite3_column_bytes(stmt, column)); }
+const unsigned char* blob(sqlite3_stmt* stmt, int column) { return static_cast<const unsigned char*>(sqlite3_column_blob(stmt, column)); }
+
+struct CsvFormatter {
+    void header(Buffer& buffer, sqlite3_stmt* stmt, int columns)
+    {
+        for (int c = 0; c < columns; c++)
+        {
+            if (c)
+                buffer.put(',');
+            const char* name = sqlite3_column_name(stmt, c);
+            write_csv_text(buffer, name, std::strlen(name));
+        }
+        buffer.put('\n');
+    }
+
+    void row(Buffer& buffer, sqlite3_stmt* stmt, int columns)
+    {
+        for (int c = 0; c < columns; c++)
+        {
+            if (c)
+                buffer.put(',');
+            switch (sqlite3_column_type(stmt, c)) {
+                case SQLITE_INTEGER:
+                    write_i64(buffer, sqlite3_column_int64(stmt, c));
+                    break;
+                case SQLITE_FLOAT:
+                    write_flt(buffer, sqlite3_column_double(stmt, c));
+                    break;
+                case SQLITE_TEXT:
+                {
+                    auto str = text(stmt, c);
+                    write_csv_text(buffer, str, bytes(stmt, c));
+                    break;
+                }
+                case SQLITE_BLOB:
+                {
+                    auto data = blob(stmt, c);
+                    write_hex(buffer, data, bytes(stmt, c));
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        buffer.put('\n');
+    }
+};
+
+struct JsonFormatter {
+    // `"name":` for every column, escaped once up front
+    std::vector<std::string> keys;
+
+    void header(Buffer&, sqlite3_stmt* stmt, int columns)
+    {
+        std::string key;
+        StringSink sink(key);
+        Buffer scratch(sink);
+        for (int c = 0; c < columns; c++)
+        {
+            const char* name = sqlite3_column_name(stmt, c);
+            scratch.put(c ? ',' : '{');
+            write_json_text(scratch, name, std::strlen(name));
+            scratch.put(':');
+            scratch.flush();
+            keys.push_back(key);
+            key.clear();
+        }
+    }
+
+    void row(Buffer& buffer, sqlite3_stmt* stmt, int columns)
+    {
+        if (columns == 0)
+            buffer.put('{');
+        for (int c = 0; c < columns; c++)
+        {
+            buffer.append(keys[c].data(), keys[c].size());
+            switch (sqlite3_column_type(stmt, c)) {
+                case SQLITE_INTEGER:
+                    write_i64(buffer, sqlite3_column_int64(stmt, c));
+                    break;
+                case SQLITE_FLOAT:
+                {
+                    double value = sqlite3_column_double(stmt, c);
+                    if (std::isfinite(value))
+                        write_flt(buffer, value);
+                    else
+                        buffer.append("null", 4);
+                    break;
+                }
+                case SQLITE_TEXT:
+                {
+                    auto str = text(stmt, c);
+                    write_json_text(buffer, str, bytes(stmt, c));
+                    break;
+                }
+                case SQLITE_BLOB:
+                {
+                    auto data = blob(stmt, c);
+                    buffer.put('"');
+                    write_hex(buffer, data, bytes(stmt, c));
+                    buffer.put('"');
+                    break;
+                }
+                default:
+                    buffer.append("null", 4);
+                    break;
+            }
+        }
+        buffer.append("}\n", 2);
+    }
+
+    struct StringSink final : Sink {
+        explicit StringSink(std::string& out) : out(out) {}
+        bool write(const char* data, std::size_t size) override { out.append(data, size); return true; }
+        std::string error_msg() const override { return std::string(); }
+        std::string& out;
+    };
+};
+
+struct BinaryFormatter {
+    enum Tag : char { null, integer, real, text, blob };
+
+    void header(Buffer& buffer, sqlite3_stmt* stmt, int columns)
+    {
+        buffer.append("SLT1", 4);
+        write_varint(buffer, static_cast<uint64_t>(columns));
+        for (int c = 0; c < columns; c++)
+        {
+            const char* name = sqlite3_column_name(stmt, c);
+            auto size = std::strlen(name);
+            write_varint(buffer, size);
+            buffer.append(name, size);
+        }
+    }
+
+    void row(Buffer& buffer, sqlite3_stmt* stmt, int columns)
+    {
+        for (int c = 0; c < columns; c++)
+        {
+            switch (sqlite3_column_type(stmt, c)) {
+                case SQLITE_INTEGER:
+                {
+                    auto value = sqlite3_column_int64(stmt, c);
+                    auto zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+                    buffer.put(integer);
+                    write_varint(buffer, zigzag);
+                    break;
+                }
+                case SQLITE_FLOAT:
+                {
+                    double value = sqlite3_column_double(stmt, c);
+                    uint64_t bits;
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    char* out = buffer.reserve(9);
+                    out[0] = real;
+                    for (int i = 0; i < 8; i++)
+                        out[1 + i] = static_cast<char>(bits >> (8 * i));
+                    buffer.commit(9);
+                    break;
+                }
+                case SQLITE_TEXT:
+                {
+                    auto str = sqlite3_column_text(stmt, c);
+                    auto size = bytes(stmt, c);
+                    buffer.put(text);
+                    write_varint(buffer, size);
+                    buffer.append(reinterpret_cast<const char*>(str), size);
+                    break;
+                }
+                case SQLITE_BLOB:
+                {
+                    auto data = sqlite3_column_blob(stmt, c);
+                    auto size = bytes(stmt, c);
+                    buffer.put(blob);
+                    write_varint(buffer, size);
+                    buffer.append(static_cast<const char*>(data), size);
+                    break;
+                }
+                default:
+                    buffer.put(null);
+                    break;
+            }
+        }
+    }
+};
+
+template<typename Formatter>
+std::size_t write_rows(Statement& statement, Statement::details& me, Sink& sink)
+{
+    Formatter formatter;
+    Buffer buffer(sink);
+    std::size_t rows = 0;
+    int columns = sqlite3_column_count(me.stmt);
+
+    formatter.header(buffer, me.stmt, columns);
+
+    bool row = statement.has_row() || statement.step();
+    while (row && buffer.ok())
+    {
+        formatter.row(buffer, me.stmt, columns);
+        rows++;
+        row = statement.step();
+    }
+    buffer.flush();
+
+    if (!buffer.ok())
+    {
+        me.sqlite_errcode = SQLITE_IOERR;
+        me.sqlite_errmsg = sink.error_msg();
+    }
+    return rows;
+}
+
+std::size_t write_rows(Statement& statement, Statement::details& me, Sink& sink, Format format)
+{
+    if (statement.error())
+        return 0;
+
+    switch (format) {
+        case Format::csv:
+            return write_rows<CsvFormatter>(statement, me, sink);
+        case Format::ndjson:
+            return write_rows<JsonFormatter>(statement, me, sink);
+        case Format::binary:
+            return write_rows<BinaryFormatter>(statement, me, sink);
+    }
+    return 0;
+}
+
+} // namespace
+
+std::size_t Statement::write_to(int fd, Format format)
+{
+    FdSink sink(fd);
+    return write_rows(*this, *me, sink, format);
+}
+
+std::size_t Statement::write_to(std::ostream& out, Format format)
+{
+    StreamSink sink(out);
+    return write_rows(*this, *me, sink, format);
+}
+
+} // namespace slight
@@ -0,0 +1,313 @@
+#include "slight_fts.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <cstdio> // snprintf
+
+namespace slight {
+
+namespace {
+
+std::string quote_identifier(const std::string& name)
+{
+    std::string quoted = "\"";
+    for (char c : name)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+std::string quote_string(const std::string& str)
+{
+    std::string quoted = "'";
+    for (char c : str)
+    {
+        if (c == '\'')
+            quoted += '\'';
+        quoted += c;
+    }
+    return quoted + "'";
+}
+
+} // namespace
+
+/// @note Owns a raw statement so that dropping the results part way, the
+///       usual top-N pattern, finalizes it and ends its read transaction.
+struct FullTextResults::details {
+    ~details() { sqlite3_finalize(stmt); }
+
+    sqlite3_stmt* stmt{nullptr};
+    FullTextHit hit{0, 0, {}};
+    int errcode{0};
+    std::string errmsg;
+};
+
+FullTextResults::FullTextResults(std::unique_ptr<details> me) : me(std::move(me)) {}
+FullTextResults::FullTextResults(FullTextResults&& other) = default;
+FullTextResults::~FullTextResults() = default;
+
+const FullTextHit& FullTextResults::iterator::operator*() const { return results->me->hit; }
+
+FullTextResults::iterator& FullTextResults::iterator::operator++()
+{
+    if (!results->next())
+        results = nullptr;
+    return *this;
+}
+
+FullTextResults::iterator FullTextResults::begin() { return iterator(next() ? this : nullptr); }
+
+bool FullTextResults::next()
+{
+    if (!me->stmt)
+        return false;
+    int rc = sqlite3_step(me->stmt);
+    if (rc != SQLITE_ROW)
+    {
+        if (rc != SQLITE_DONE)
+        {
+            me->errcode = rc;
+            me->errmsg = sqlite3_errmsg(sqlite3_db_handle(me->stmt));
+        }
+        // done either way; let go of the read transaction now
+        sqlite3_finalize(me->stmt);
+        me->stmt = nullptr;
+        return false;
+    }
+    me->hit.rowid = sqlite3_column_int64(me->stmt, 0);
+    me->hit.rank = sqlite3_column_double(me->stmt, 1);
+    auto snippet = reinterpret_cast<const char*>(sqlite3_column_text(me->stmt, 2));
+    me->hit.snippet.assign(snippet ? snippet : "", static_cast<std::size_t>(sqlite3_column_bytes(me->stmt, 2)));
+    return true;
+}
+
+bool FullTextResults::error() const { return me->errcode != 0; }
+int FullTextResults::error_code() const { return me->errcode; }
+const std::string& FullTextResults::error_msg() const { return me->errmsg; }
+
+FullTextIndex::FullTextIndex(Database& db, const std::string& table, const std::vector<std::string>& columns,
+                             const FullTextOptions& options)
+    : db(db)
+    , table(table)
+    , quoted(quote_identifier(table))
+    , n_columns(columns.size())
+    , options(options)
+{
+    std::string create = "CREATE VIRTUAL TABLE IF NOT EXISTS " + quoted + " USING fts5(";
+    for (const auto& column : columns)
+    {
+        create += quote_identifier(column) + ", ";
+        insert_columns += ", " + quote_identifier(column);
+    }
+    create += "tokenize = " + quote_string(options.tokenize) + ")";
+    exec(create);
+}
+
+bool FullTextIndex::fail()
+{
+    errcode = sqlite3_errcode(db.handle());
+    errmsg = sqlite3_errmsg(db.handle());
+    return false;
+}
+
+bool FullTextIndex::exec(const std::string& sql)
+{
+    int rc = sqlite3_exec(db.handle(), sql.c_str(), nullptr, nullptr, nullptr);
+    Database::details::of(db).changes.after_commit(db.handle());
+    return rc == SQLITE_OK || fail();
+}
+
+bool FullTextIndex::configure(const char* setting, int value)
+{
+    std::string sql = "INSERT INTO " + quoted + "(" + quoted + ", rank) VALUES (?, ?)";
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, setting, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, value);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    Database::details::of(db).changes.after_commit(db.handle());
+    return rc == SQLITE_DONE || fail();
+}
+
+int FullTextIndex::setting(const char* name, int fallback)
+{
+    std::string sql = "SELECT v FROM " + quote_identifier(table + "_config") + " WHERE k = ?";
+    sqlite3_stmt* stmt = nullptr;
+    int value = fallback;
+    int rc = sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW)
+        {
+            value = sqlite3_column_int(stmt, 0);
+            rc = SQLITE_DONE;
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE)
+        fail();
+    return value;
+}
+
+std::size_t FullTextIndex::add(const std::vector<FullTextDocument>& documents)
+{
+    errcode = 0;
+    errmsg.clear();
+
+    std::string sql = "INSERT OR REPLACE INTO " + quoted + "(rowid" + insert_columns + ") VALUES (?";
+    for (std::size_t c = 0; c < n_columns; c++)
+        sql += ", ?";
+    sql += ")";
+    sqlite3_stmt* raw = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &raw, nullptr) != SQLITE_OK)
+    {
+        fail();
+        return 0;
+    }
+    std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)> insert(raw, &sqlite3_finalize);
+
+    // put back when done; a missing row means FTS5's default
+    const int automerge = setting("automerge", 4);
+    const int crisismerge = setting("crisismerge", 16);
+    if (errcode)
+        return 0;
+
+    // keeps the first failure, if any
+    auto restore = [&]() {
+        int failed = errcode;
+        std::string failed_msg = errmsg;
+        bool done = configure("automerge", automerge) && configure("crisismerge", crisismerge);
+        if (failed)
+        {
+            errcode = failed;
+            errmsg = failed_msg;
+        }
+        return done;
+    };
+
+    const bool own_transaction = sqlite3_get_autocommit(db.handle()) != 0;
+    std::size_t added = 0;
+    std::size_t in_transaction = 0;
+    bool ok = (!own_transaction || exec("BEGIN")) && configure("automerge", options.load_automerge)
+            && configure("crisismerge", options.load_crisismerge);
+    for (std::size_t d = 0; ok && d < documents.size(); d++)
+    {
+        const auto& document = documents[d];
+        sqlite3_bind_int64(insert.get(), 1, document.rowid);
+        for (std::size_t c = 0; c < n_columns; c++)
+        {
+            // borrowed: the documents outlive the step
+            int column = static_cast<int>(c) + 2;
+            if (c < document.columns.size())
+                sqlite3_bind_text(insert.get(), column, document.columns[c].data(),
+                                  static_cast<int>(document.columns[c].size()), SQLITE_STATIC);
+            else
+                sqlite3_bind_text(insert.get(), column, "", 0, SQLITE_STATIC);
+        }
+        int rc = sqlite3_step(insert.get());
+        if (rc != SQLITE_DONE)
+            fail();
+        sqlite3_reset(insert.get());
+        if (rc != SQLITE_DONE)
+        {
+            ok = false;
+            break;
+        }
+
+        in_transaction++;
+        if (own_transaction && in_transaction >= options.transaction_documents)
+        {
+            if (!exec("COMMIT"))
+            {
+                ok = false;
+                break;
+            }
+            added += in_transaction;
+            in_transaction = 0;
+            ok = exec("BEGIN");
+        }
+    }
+
+    // restored in the load's own transaction, so its COMMIT never leaves
+    // the load settings behind
+    if (!own_transaction)
+    {
+        restore();
+        if (ok)
+            added += in_transaction;
+    }
+    else if (ok && restore() && exec("COMMIT"))
+    {
+        added += in_transaction;
+    }
+    else
+    {
+        if (!sqlite3_get_autocommit(db.handle()))
+            sqlite3_exec(db.handle(), "ROLLBACK", nullptr, nullptr, nullptr);
+        // earlier batches committed the load settings
+        if (added)
+            restore();
+    }
+    return added;
+}
+
+bool FullTextIndex::remove(std::int64_t rowid)
+{
+    std::string sql = "DELETE FROM " + quoted + " WHERE rowid = ?";
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_int64(stmt, 1, rowid);
+        rc = sqlite3_step(stmt);
+    }
+    if (rc != SQLITE_DONE)
+        fail();
+    sqlite3_finalize(stmt);
+    Database::details::of(db).changes.after_commit(db.handle());
+    return rc == SQLITE_DONE;
+}
+
+FullTextResults FullTextIndex::search(const std::string& match, const FullTextQuery& query)
+{
+    char number[32];
+    std::string rank = "bm25(" + quoted;
+    for (std::size_t c = 0; c < query.weights.size() && c < n_columns; c++)
+    {
+        std::snprintf(number, sizeof(number), "%.17g", query.weights[c]);
+        rank += std::string(", ") + number;
+    }
+    rank += ")";
+
+    std::string sql = "SELECT rowid, " + rank + ", snippet(" + quoted + ", " + std::to_string(query.snippet_column)
+            + ", " + quote_string(query.open) + ", " + quote_string(query.close) + ", "
+            + quote_string(query.ellipsis) + ", " + std::to_string(query.snippet_tokens) + ") FROM " + quoted
+            + " WHERE " + quoted + " MATCH ? ORDER BY " + rank + " LIMIT ? OFFSET ?";
+
+    std::unique_ptr<FullTextResults::details> results(new FullTextResults::details());
+    if (sqlite3_prepare_v3(db.handle(), sql.c_str(), -1, 0, &results->stmt, nullptr) != SQLITE_OK)
+    {
+        results->errcode = sqlite3_errcode(db.handle());
+        results->errmsg = sqlite3_errmsg(db.handle());
+        sqlite3_finalize(results->stmt);
+        results->stmt = nullptr;
+        return FullTextResults(std::move(results));
+    }
+    sqlite3_bind_text(results->stmt, 1, match.data(), static_cast<int>(match.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_int64(results->stmt, 2, static_cast<sqlite3_int64>(query.limit));
+    sqlite3_bind_int64(results->stmt, 3, static_cast<sqlite3_int64>(query.offset));
+    return FullTextResults(std::move(results));
+}
+
+bool FullTextIndex::optimize() { return exec("INSERT INTO " + quoted + "(" + quoted + ") VALUES ('optimize')"); }
+
+} // namespace slight
@@ -0,0 +1,90 @@
+#include "slight_json.h"
+
+namespace slight {
+
+namespace {
+
+std::shared_ptr<Statement> walk(Database& db, const char* function, const char* json, const char* path)
+{
+    std::string sql = "SELECT key, value, type, atom, id, parent, fullkey, path FROM ";
+    sql += function;
+    sql += path ? "(?1, ?2)" : "(?1)";
+
+    auto stmt = db.prepare(sql);
+    if (stmt->ready())
+    {
+        stmt->bind(Bind(1, json));
+        if (path)
+            stmt->bind(Bind(2, path));
+    }
+    return stmt;
+}
+
+} // namespace
+
+std::shared_ptr<Statement> json_each(Database& db, const char* json, const char* path)
+{
+    return walk(db, "json_each", json, path);
+}
+
+std::shared_ptr<Statement> json_tree(Database& db, const char* json, const char* path)
+{
+    return walk(db, "json_tree", json, path);
+}
+
+std::shared_ptr<Statement> json_extract(Database& db, const char* json, std::initializer_list<const char*> paths)
+{
+    std::string sql = "SELECT ";
+    for (std::size_t i = 0; i < paths.size(); i++)
+    {
+        if (i)
+            sql += ", ";
+        sql += "json_extract(?1, ?" + std::to_string(i + 2) + ")";
+    }
+    if (paths.size() == 0)
+        sql += "NULL";
+
+    auto stmt = db.prepare(sql);
+    if (!stmt->ready())
+        return stmt;
+
+    stmt->bind(Bind(1, json));
+    int index = 2;
+    for (auto path : paths)
+        stmt->bind(Bind(index++, path));
+    stmt->step();
+    return stmt;
+}
+
+void json_quote(std::string& out, const char* str, std::size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    out.reserve(out.size() + size + 2);
+    out.push_back('"');
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        auto c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        out.append(str + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out.push_back(digits[c >> 4]);
+                out.push_back(digits[c & 0xf]);
+                break;
+        }
+    }
+    out.append(str + run, size - run);
+    out.push_back('"');
+}
+
+} // namespace slight
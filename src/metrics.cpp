@@ -0,0 +1,74 @@
+#include "metrics.h"
+#include "details.h"
+#include "sqlite3.h"
+
+namespace slight {
+
+namespace {
+
+std::atomic<unsigned> next_shard{0};
+
+} // namespace
+
+MetricsRegistry::MetricsRegistry()
+{
+    for (auto& shard : shards)
+        for (auto& value : shard.values)
+            value.store(0, std::memory_order_relaxed);
+}
+
+MetricsRegistry::Shard& MetricsRegistry::local()
+{
+    static thread_local unsigned shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+    return shards[shard % n_shards];
+}
+
+Metrics MetricsRegistry::snapshot() const
+{
+    uint64_t totals[n_counters + n_error_codes] = {};
+    for (const auto& shard : shards)
+        for (int i = 0; i < n_counters + n_error_codes; i++)
+            totals[i] += shard.values[i].load(std::memory_order_relaxed);
+
+    Metrics metrics;
+    metrics.prepares = totals[prepares];
+    metrics.result_cache_hits = totals[result_cache_hits];
+    metrics.steps = totals[steps];
+    metrics.rows = totals[rows];
+    metrics.bytes_bound = totals[bytes_bound];
+    metrics.bytes_read = totals[bytes_read];
+    metrics.busy_waits = totals[busy_waits];
+    metrics.commits = totals[commits];
+    metrics.rollbacks = totals[rollbacks];
+    for (int code = 0; code < n_error_codes; code++)
+        if (totals[n_counters + code])
+            metrics.errors[code] = totals[n_counters + code];
+    return metrics;
+}
+
+Metrics Database::metrics_snapshot() const
+{
+    auto metrics = me->metrics.snapshot();
+
+    struct { int op; int* value; bool highwater; } status[] = {
+        {SQLITE_DBSTATUS_CACHE_HIT, &metrics.cache_hit, false},
+        {SQLITE_DBSTATUS_CACHE_MISS, &metrics.cache_miss, false},
+        {SQLITE_DBSTATUS_CACHE_WRITE, &metrics.cache_write, false},
+        {SQLITE_DBSTATUS_CACHE_USED, &metrics.cache_used, false},
+        {SQLITE_DBSTATUS_LOOKASIDE_USED, &metrics.lookaside_used, false},
+        {SQLITE_DBSTATUS_LOOKASIDE_HIT, &metrics.lookaside_hit, true},
+        {SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, &metrics.lookaside_miss_size, true},
+        {SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, &metrics.lookaside_miss_full, true},
+        {SQLITE_DBSTATUS_SCHEMA_USED, &metrics.schema_used, false},
+        {SQLITE_DBSTATUS_STMT_USED, &metrics.stmt_used, false},
+    };
+    for (const auto& s : status)
+    {
+        int current = 0, highwater = 0;
+        sqlite3_db_status(me->db, s.op, &current, &highwater, 0);
+        *s.value = s.highwater ? highwater : current;
+    }
+    return metrics;
+}
+
+} // namespace slight
@@ -0,0 +1,60 @@
+#ifndef SLIGHT_METRICS_H
+#define SLIGHT_METRICS_H
+
+#include "slight.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace slight {
+
+/// @brief Event counters of one connection, sharded by thread.
+///
+/// @note Each thread adds to its own cache-line padded shard with relaxed
+///       atomics, so counting costs an uncontended add; snapshot() sums
+///       the shards.
+struct MetricsRegistry {
+    enum Counter {
+        prepares,
+        result_cache_hits,
+        steps,
+        rows,
+        bytes_bound,
+        bytes_read,
+        busy_waits,
+        commits,
+        rollbacks,
+        n_counters
+    };
+
+    static const int n_error_codes = 32; // primary result codes, rc & 0xff
+    static const unsigned n_shards = 16;
+
+    MetricsRegistry();
+
+    void add(Counter counter, uint64_t n = 1) { local().values[counter].fetch_add(n, std::memory_order_relaxed); }
+
+    void error(int rc)
+    {
+        int code = rc & 0xff;
+        local().values[n_counters + (code < n_error_codes ? code : n_error_codes - 1)]
+            .fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @brief Counter totals; sqlite3_db_status fields are left to the caller.
+    Metrics snapshot() const;
+
+    // padded to whole cache lines; alignas would need C++17 aligned new
+    struct Shard {
+        std::atomic<uint64_t> values[n_counters + n_error_codes];
+        char padding[64 - (n_counters + n_error_codes) * sizeof(uint64_t) % 64];
+    };
+
+    Shard& local();
+
+    Shard shards[n_shards];
+};
+
+} // namespace slight
+
+#endif // SLIGHT_METRICS_H
@@ -0,0 +1,133 @@
+#include "slight_prefetch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace slight {
+
+namespace {
+
+/// @brief Lets one thread sleep until another makes progress, costing the
+///        other side one atomic load when nobody sleeps.
+class Waiter {
+public:
+    template<typename Ready>
+    void wait(Ready ready)
+    {
+        for (int spin = 0; spin < 64; spin++)
+        {
+            if (ready())
+                return;
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true);
+        wake.wait(lock, ready);
+        sleeping.store(false);
+    }
+
+    void notify()
+    {
+        if (sleeping.load())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+private:
+    std::atomic<bool> sleeping{false};
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+} // namespace
+
+struct PrefetchCursor::details {
+    details(std::shared_ptr<Statement> statement, const PrefetchOptions& options)
+        : statement(std::move(statement))
+        , batch_rows(options.batch_rows ? options.batch_rows : 1)
+        , ring(options.depth ? options.depth : 1) {}
+
+    void produce();
+
+    std::shared_ptr<Statement> statement;
+    const std::size_t batch_rows;
+
+    std::vector<RowBuffer> ring;
+    std::atomic<std::size_t> written{0}; // batches published by the producer
+    std::atomic<std::size_t> read{0};    // batches handed back by the consumer
+    std::atomic<bool> finished{false};
+    std::atomic<bool> stopping{false};
+
+    Waiter producer;
+    Waiter consumer;
+
+    bool started = false; // consumer only: holds batch read % depth
+    std::thread thread;
+};
+
+void PrefetchCursor::details::produce()
+{
+    for (std::size_t w = 0; ; w++)
+    {
+        producer.wait([&] { return w - read.load() < ring.size() || stopping.load(); });
+        if (stopping.load())
+            break;
+
+        auto& batch = ring[w % ring.size()];
+        statement->step_batch(batch, batch_rows);
+        bool last = batch.size() < batch_rows;
+        if (!batch.empty())
+            written.store(w + 1);
+        if (last)
+            break;
+        consumer.notify();
+    }
+
+    finished.store(true);
+    consumer.notify();
+}
+
+PrefetchCursor::PrefetchCursor(std::shared_ptr<Statement> statement, const PrefetchOptions& options)
+    : me(new details(std::move(statement), options))
+{
+    me->thread = std::thread(&details::produce, me.get());
+}
+
+PrefetchCursor::~PrefetchCursor()
+{
+    me->stopping.store(true);
+    me->producer.notify();
+    me->thread.join();
+}
+
+const RowBuffer* PrefetchCursor::next()
+{
+    if (me->started)
+    {
+        me->read.fetch_add(1);
+        me->producer.notify();
+    }
+
+    auto r = me->read.load();
+    me->consumer.wait([&] { return me->written.load() > r || me->finished.load(); });
+    if (me->written.load() > r)
+    {
+        me->started = true;
+        return &me->ring[r % me->ring.size()];
+    }
+
+    me->started = false;
+    return nullptr;
+}
+
+bool PrefetchCursor::error() const { return me->statement->error(); }
+int PrefetchCursor::error_code() const { return me->statement->error_code(); }
+const std::string& PrefetchCursor::error_msg() const { return me->statement->error_msg(); }
+
+} // namespace slight
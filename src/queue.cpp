@@ -0,0 +1,269 @@
+#include "slight_queue.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace slight {
+
+namespace {
+
+struct Node {
+    std::atomic<Node*> next{nullptr};
+    WriteJob job;
+    std::promise<int> promise;
+    int result = SQLITE_OK;
+    std::exception_ptr exception;
+};
+
+/// @brief Intrusive MPSC queue (Vyukov): push is one exchange, pop is
+///        consumer-only.
+class MpscQueue {
+public:
+    MpscQueue() : head(&stub), tail(&stub) {}
+
+    void push(Node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /// @returns the oldest node, or nullptr when empty or when a push is
+    ///          half done.
+    ///
+    /// @note The returned node stays linked as the new tail. The node it
+    ///       replaces is appended to retired for the caller to free once
+    ///       done with it.
+    Node* pop(std::vector<Node*>& retired)
+    {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return nullptr;
+        if (tail != &stub)
+            retired.push_back(tail);
+        tail = next;
+        return next;
+    }
+
+    ~MpscQueue()
+    {
+        if (tail != &stub)
+            delete tail;
+    }
+
+private:
+    std::atomic<Node*> head;
+    Node* tail;
+    Node stub;
+};
+
+bool ok(int rc) { return rc == SQLITE_OK || rc == SQLITE_ROW || rc == SQLITE_DONE; }
+
+} // namespace
+
+struct WriteQueue::details {
+    details(std::unique_ptr<Database> db, const WriteQueueOptions& options)
+        : db(std::move(db)), options(options) {}
+    ~details()
+    {
+        for (auto& entry : statements)
+            sqlite3_finalize(entry.second);
+    }
+
+    void run();
+    void run_batch();
+    int exec(const std::string& sql);
+
+    Node* pop();
+
+    std::unique_ptr<Database> db;
+    const WriteQueueOptions options;
+
+    MpscQueue queue;
+    std::atomic<std::size_t> pending{0};
+
+    std::mutex mutex; // only for sleeping and waking the writer
+    std::condition_variable wake;
+    bool stopping = false;
+
+    std::unordered_map<std::string, sqlite3_stmt*> statements; // writer only
+    std::vector<Node*> retired; // writer only
+
+    std::atomic<std::uint64_t> jobs{0};
+    std::atomic<std::uint64_t> batches{0};
+    std::atomic<std::uint64_t> failed_jobs{0};
+
+    std::thread writer;
+};
+
+/// @brief Step a cached statement once and reset it.
+int WriteQueue::details::exec(const std::string& sql)
+{
+    auto& stmt = statements[sql];
+    if (!stmt)
+    {
+        int rc = sqlite3_prepare_v3(db->handle(), sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+        if (rc != SQLITE_OK)
+        {
+            statements.erase(sql);
+            return rc;
+        }
+    }
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc;
+}
+
+Node* WriteQueue::details::pop()
+{
+    Node* node = queue.pop(retired);
+    if (node)
+        pending.fetch_sub(1, std::memory_order_relaxed);
+    return node;
+}
+
+void WriteQueue::details::run()
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return pending.load() > 0 || stopping; });
+            if (pending.load() == 0)
+                return;
+        }
+        run_batch();
+    }
+}
+
+void WriteQueue::details::run_batch()
+{
+    std::vector<Node*> batch;
+    auto deadline = std::chrono::steady_clock::now() + options.max_latency;
+
+    int rc = exec("BEGIN IMMEDIATE");
+    while (batch.size() < options.max_batch)
+    {
+        Node* node = pop();
+        if (!node)
+        {
+            if (pending.load() > 0)
+            {
+                std::this_thread::yield(); // a push is between its two stores
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping || !wake.wait_until(lock, deadline, [this] { return pending.load() > 0 || stopping; }))
+                break;
+            continue;
+        }
+
+        batch.push_back(node);
+        if (!ok(rc))
+            continue; // no transaction to run in; the whole batch fails below
+
+        auto& changes = Database::details::of(*db).changes;
+        auto mark = changes.mark();
+        exec("SAVEPOINT write_queue_job");
+        try
+        {
+            node->result = node->job(*db);
+        }
+        catch (...)
+        {
+            node->exception = std::current_exception();
+        }
+        if (node->exception || !ok(node->result))
+        {
+            exec("ROLLBACK TO write_queue_job");
+            changes.rollback_to(mark);
+        }
+        exec("RELEASE write_queue_job");
+        node->job = nullptr;
+    }
+
+    if (ok(rc))
+        rc = exec("COMMIT");
+    if (!ok(rc) && !sqlite3_get_autocommit(db->handle()))
+        exec("ROLLBACK");
+    Database::details::of(*db).changes.after_commit(db->handle());
+
+    batches++;
+    jobs += batch.size();
+    for (auto node : batch)
+    {
+        if (node->exception)
+        {
+            failed_jobs++;
+            node->promise.set_exception(node->exception);
+        }
+        else
+        {
+            int result = !ok(rc) ? rc : ok(node->result) ? SQLITE_OK : node->result;
+            if (result != SQLITE_OK)
+                failed_jobs++;
+            node->promise.set_value(result);
+        }
+    }
+
+    for (auto node : retired)
+        delete node;
+    retired.clear();
+}
+
+WriteQueue::WriteQueue(std::unique_ptr<Database> db, const WriteQueueOptions& options)
+    : me(new details(std::move(db), options))
+{
+    me->writer = std::thread(&details::run, me.get());
+}
+
+WriteQueue::~WriteQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(me->mutex);
+        me->stopping = true;
+    }
+    me->wake.notify_one();
+    me->writer.join();
+}
+
+std::future<int> WriteQueue::submit(WriteJob job)
+{
+    auto node = new Node;
+    node->job = std::move(job);
+    auto future = node->promise.get_future();
+
+    // count first so the writer never sees a node it has not been told about
+    bool idle = me->pending.fetch_add(1) == 0;
+    me->queue.push(node);
+    if (idle)
+    {
+        std::lock_guard<std::mutex> lock(me->mutex);
+        me->wake.notify_one();
+    }
+    return future;
+}
+
+std::future<int> WriteQueue::submit(const std::string& sql)
+{
+    auto m = me.get();
+    return submit([m, sql](Database&) { return m->exec(sql); });
+}
+
+WriteQueueStats WriteQueue::stats() const
+{
+    WriteQueueStats stats;
+    stats.jobs = me->jobs;
+    stats.batches = me->batches;
+    stats.failed_jobs = me->failed_jobs;
+    return stats;
+}
+
+} // namespace slight
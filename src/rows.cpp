@@ -0,0 +1,143 @@
+#include "slight.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <cstdlib> // strtoll, strtod
+
+namespace slight {
+
+void RowBuffer::clear()
+{
+    cells.clear();
+    arena.clear();
+    n_rows = 0;
+}
+
+std::size_t RowBuffer::bytes() const { return sizeof(*this) + cells.capacity() * sizeof(Cell) + arena.capacity(); }
+
+uint64_t RowBuffer::append(sqlite3_stmt* stmt)
+{
+    uint64_t bytes = 0;
+    for (int c = 0; c < n_columns; c++)
+    {
+        Cell cell;
+        cell.size = 0;
+        switch (sqlite3_column_type(stmt, c)) {
+            case SQLITE_INTEGER:
+                cell.type = i64;
+                cell.i = sqlite3_column_int64(stmt, c);
+                break;
+            case SQLITE_FLOAT:
+                cell.type = flt;
+                cell.f = sqlite3_column_double(stmt, c);
+                break;
+            case SQLITE_TEXT:
+            case SQLITE_BLOB:
+            {
+                bool is_text = sqlite3_column_type(stmt, c) == SQLITE_TEXT;
+                auto data = is_text ? sqlite3_column_text(stmt, c) : sqlite3_column_blob(stmt, c);
+                auto size = sqlite3_column_bytes(stmt, c);
+                cell.type = is_text ? text : blob;
+                cell.offset = arena.size();
+                cell.size = static_cast<uint32_t>(size);
+                arena.append(static_cast<const char*>(data), static_cast<std::size_t>(size));
+                arena.push_back('\0');
+                bytes += cell.size;
+                break;
+            }
+            default:
+                cell.type = nil;
+                cell.i = 0;
+                break;
+        }
+        if (cell.type != text && cell.type != blob)
+            bytes += 8;
+        cells.push_back(cell);
+    }
+    n_rows++;
+    return bytes;
+}
+
+ColumnType RowBuffer::Row::column_type(int index) const
+{
+    return static_cast<ColumnType>(buffer->cell(row, index).type);
+}
+
+bool RowBuffer::Row::is_null(int index) const { return buffer->cell(row, index).type == nil; }
+
+// conversions follow sqlite3_column_* for numeric and text cells
+
+template<>
+Typer<i64>::Type RowBuffer::Row::get<i64>(int index) const
+{
+    const auto& c = buffer->cell(row, index);
+    switch (c.type) {
+        case i64: return c.i;
+        case flt: return static_cast<int64_t>(c.f);
+        case text: return std::strtoll(buffer->arena.c_str() + c.offset, nullptr, 10);
+        default: return 0;
+    }
+}
+
+template<>
+Typer<i32>::Type RowBuffer::Row::get<i32>(int index) const { return static_cast<Typer<i32>::Type>(get<i64>(index)); }
+
+template<>
+Typer<u32>::Type RowBuffer::Row::get<u32>(int index) const { return static_cast<Typer<u32>::Type>(get<i64>(index)); }
+
+template<>
+Typer<flt>::Type RowBuffer::Row::get<flt>(int index) const
+{
+    const auto& c = buffer->cell(row, index);
+    switch (c.type) {
+        case i64: return static_cast<double>(c.i);
+        case flt: return c.f;
+        case text: return std::strtod(buffer->arena.c_str() + c.offset, nullptr);
+        default: return 0;
+    }
+}
+
+template<>
+Typer<text>::Type RowBuffer::Row::get<text>(int index) const
+{
+    const auto& c = buffer->cell(row, index);
+    return c.type == text ? buffer->arena.c_str() + c.offset : nullptr;
+}
+
+template<>
+Typer<text_view>::Type RowBuffer::Row::get<text_view>(int index) const
+{
+    const auto& c = buffer->cell(row, index);
+    return c.type == text ? TextView{buffer->arena.data() + c.offset, c.size} : TextView{nullptr, 0};
+}
+
+void RowBuffer::Row::get_into(int index, std::string& out) const
+{
+    auto view = get<text_view>(index);
+    out.assign(view.data ? view.data : "", view.size);
+}
+
+template<>
+Typer<datetime>::Type RowBuffer::Row::get<datetime>(int index) const
+{
+    const auto& c = buffer->cell(row, index);
+    DateTime value;
+    if (c.type == i64)
+        value = DateTime(std::chrono::microseconds(c.i));
+    else if (c.type == text)
+        parse_iso8601(buffer->arena.data() + c.offset, c.size, value);
+    return value;
+}
+
+std::size_t Statement::step_batch(RowBuffer& buffer, std::size_t n)
+{
+    buffer.clear();
+    buffer.n_columns = sqlite3_column_count(me->stmt);
+    uint64_t bytes = 0;
+    while (buffer.n_rows < n && step())
+        bytes += buffer.append(me->stmt);
+    me->database->metrics.add(MetricsRegistry::bytes_read, bytes);
+    return buffer.n_rows;
+}
+
+} // namespace slight
@@ -0,0 +1,269 @@
+#include "slight_rtree.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <cmath> // nextafter
+#include <limits>
+
+namespace slight {
+
+namespace spatial_details {
+
+namespace {
+
+std::string quote_identifier(const std::string& name)
+{
+    std::string quoted = "\"";
+    for (char c : name)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+} // namespace
+
+struct Index::details {
+    Database& db;
+    std::size_t dims;
+    bool prepared{false};
+    sqlite3_stmt* insert{nullptr};
+    sqlite3_stmt* remove{nullptr};
+    sqlite3_stmt* queries[3]{nullptr, nullptr, nullptr};
+
+    details(Database& db, std::size_t dims) : db(db), dims(dims) {}
+
+    ~details()
+    {
+        sqlite3_finalize(insert);
+        sqlite3_finalize(remove);
+        for (auto stmt : queries)
+            sqlite3_finalize(stmt);
+    }
+
+    /// @brief Step stmt to completion and reset it; a write outside a
+    ///        transaction commits, so change subscribers are told.
+    int run(sqlite3_stmt* stmt)
+    {
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        Database::details::of(db).changes.after_commit(db.handle());
+        return rc;
+    }
+};
+
+Index::Index(Database& db, const std::string& table, std::size_t dims, bool integer)
+    : me(new details(db, dims))
+{
+    auto quoted = quote_identifier(table);
+    std::string columns = "id";
+    std::string values = "?1";
+    for (std::size_t d = 0; d < dims; d++)
+    {
+        columns += ", min" + std::to_string(d) + ", max" + std::to_string(d);
+        values += ", ?" + std::to_string(2 * d + 2) + ", ?" + std::to_string(2 * d + 3);
+    }
+
+    // the query box's min and max on dimension d are ?(2d + 1) and ?(2d + 2)
+    std::string where[3];
+    for (std::size_t d = 0; d < dims; d++)
+    {
+        auto n = std::to_string(d);
+        auto lo = "?" + std::to_string(2 * d + 1);
+        auto hi = "?" + std::to_string(2 * d + 2);
+        auto conjunction = d ? " AND " : "";
+        where[0] += conjunction + ("max" + n + " >= " + lo + " AND min" + n + " <= " + hi);
+        where[1] += conjunction + ("min" + n + " >= " + lo + " AND max" + n + " <= " + hi);
+        where[2] += conjunction + ("min" + n + " <= " + lo + " AND max" + n + " >= " + hi);
+    }
+
+    auto db_handle = db.handle();
+    std::string create = "CREATE VIRTUAL TABLE IF NOT EXISTS " + quoted + " USING "
+            + (integer ? "rtree_i32(" : "rtree(") + columns + ")";
+    int rc = sqlite3_exec(db_handle, create.c_str(), nullptr, nullptr, nullptr);
+
+    auto prepare = [&](const std::string& sql, sqlite3_stmt** stmt) {
+        if (rc == SQLITE_OK)
+            rc = sqlite3_prepare_v3(db_handle, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, stmt, nullptr);
+    };
+    prepare("INSERT OR REPLACE INTO " + quoted + "(" + columns + ") VALUES (" + values + ")", &me->insert);
+    prepare("DELETE FROM " + quoted + " WHERE id = ?1", &me->remove);
+    for (int r = 0; r < 3; r++)
+        prepare("SELECT id FROM " + quoted + " WHERE " + where[r], &me->queries[r]);
+
+    me->prepared = rc == SQLITE_OK;
+    if (!me->prepared)
+    {
+        errcode = rc;
+        errmsg = sqlite3_errmsg(db_handle);
+    }
+}
+
+Index::~Index() { delete me; }
+
+bool Index::start()
+{
+    if (!me->prepared)
+        return false;
+    errcode = 0;
+    errmsg.clear();
+    return true;
+}
+
+bool Index::begin()
+{
+    if (!start() || !sqlite3_get_autocommit(me->db.handle()))
+        return false;
+    return sqlite3_exec(me->db.handle(), "BEGIN", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+bool Index::insert(std::int64_t rowid, const double* min, const double* max)
+{
+    if (!start())
+        return false;
+    sqlite3_bind_int64(me->insert, 1, rowid);
+    for (std::size_t d = 0; d < me->dims; d++)
+    {
+        sqlite3_bind_double(me->insert, static_cast<int>(2 * d + 2), min[d]);
+        sqlite3_bind_double(me->insert, static_cast<int>(2 * d + 3), max[d]);
+    }
+    int rc = me->run(me->insert);
+    if (rc != SQLITE_DONE)
+    {
+        errcode = rc;
+        errmsg = sqlite3_errmsg(me->db.handle());
+        return false;
+    }
+    return true;
+}
+
+bool Index::insert(std::int64_t rowid, const std::int32_t* min, const std::int32_t* max)
+{
+    if (!start())
+        return false;
+    sqlite3_bind_int64(me->insert, 1, rowid);
+    for (std::size_t d = 0; d < me->dims; d++)
+    {
+        sqlite3_bind_int(me->insert, static_cast<int>(2 * d + 2), min[d]);
+        sqlite3_bind_int(me->insert, static_cast<int>(2 * d + 3), max[d]);
+    }
+    int rc = me->run(me->insert);
+    if (rc != SQLITE_DONE)
+    {
+        errcode = rc;
+        errmsg = sqlite3_errmsg(me->db.handle());
+        return false;
+    }
+    return true;
+}
+
+std::size_t Index::end(bool opened, std::size_t inserted)
+{
+    if (!opened)
+        return inserted;
+
+    auto db_handle = me->db.handle();
+    int rc = error() ? SQLITE_ERROR : sqlite3_exec(db_handle, "COMMIT", nullptr, nullptr, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        if (!error())
+        {
+            errcode = rc;
+            errmsg = sqlite3_errmsg(db_handle);
+        }
+        if (!sqlite3_get_autocommit(db_handle))
+            sqlite3_exec(db_handle, "ROLLBACK", nullptr, nullptr, nullptr);
+        inserted = 0;
+    }
+    Database::details::of(me->db).changes.after_commit(db_handle);
+    return inserted;
+}
+
+bool Index::remove(std::int64_t rowid)
+{
+    if (!start())
+        return false;
+    sqlite3_bind_int64(me->remove, 1, rowid);
+    int rc = me->run(me->remove);
+    if (rc != SQLITE_DONE)
+    {
+        errcode = rc;
+        errmsg = sqlite3_errmsg(me->db.handle());
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+bool collect(sqlite3_stmt* stmt, std::vector<std::int64_t>& out, int& errcode, std::string& errmsg)
+{
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        out.push_back(sqlite3_column_int64(stmt, 0));
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        errcode = rc;
+        errmsg = sqlite3_errmsg(sqlite3_db_handle(stmt));
+        return false;
+    }
+    return true;
+}
+
+/// @brief A float at or past what rtree stores for edge value d, rounded
+///        down (direction -1) for a min or up (1) for a max.
+///
+/// @note sqlite's rtreeValueDown/Up step off by a relative 2^-23 when the
+///       nearest float is on the wrong side; one more float covers that.
+double stored(double d, int direction)
+{
+    const double step = 1.0 / 8388608.0;
+    float f = static_cast<float>(d);
+    if (direction < 0 ? f > d : f < d)
+        f = static_cast<float>(d * ((d < 0) == (direction < 0) ? 1 + step : 1 - step));
+    return std::nextafter(f, direction * std::numeric_limits<float>::infinity());
+}
+
+} // namespace
+
+bool Index::query(Relation relation, const double* min, const double* max, std::vector<std::int64_t>& out)
+{
+    if (!start())
+        return false;
+    auto stmt = me->queries[static_cast<int>(relation)];
+    for (std::size_t d = 0; d < me->dims; d++)
+    {
+        double lo = min[d];
+        double hi = max[d];
+        // stored edges are rounded outwards, so a box exactly inside this
+        // one may now stick out of it; widen by as much
+        if (relation == Relation::within)
+        {
+            lo = stored(lo, -1);
+            hi = stored(hi, 1);
+        }
+        sqlite3_bind_double(stmt, static_cast<int>(2 * d + 1), lo);
+        sqlite3_bind_double(stmt, static_cast<int>(2 * d + 2), hi);
+    }
+    return collect(stmt, out, errcode, errmsg);
+}
+
+bool Index::query(Relation relation, const std::int32_t* min, const std::int32_t* max, std::vector<std::int64_t>& out)
+{
+    if (!start())
+        return false;
+    auto stmt = me->queries[static_cast<int>(relation)];
+    for (std::size_t d = 0; d < me->dims; d++)
+    {
+        sqlite3_bind_int(stmt, static_cast<int>(2 * d + 1), min[d]);
+        sqlite3_bind_int(stmt, static_cast<int>(2 * d + 2), max[d]);
+    }
+    return collect(stmt, out, errcode, errmsg);
+}
+
+} // namespace spatial_details
+
+} // namespace slight
@@ -0,0 +1,138 @@
+#include "slight_scan.h"
+#include "cache.h"
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace slight {
+
+namespace {
+
+struct Range {
+    int64_t lo;
+    int64_t hi;
+};
+
+/// @brief Cut [lo, hi] into at most partitions equal-width ranges.
+std::vector<Range> split(int64_t lo, int64_t hi, std::size_t partitions)
+{
+    // offsets from lo, in unsigned arithmetic so the full int64 range fits
+    uint64_t last = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+    uint64_t width = last / partitions + 1;
+
+    std::vector<Range> ranges;
+    for (uint64_t offset = 0; ; offset += width)
+    {
+        uint64_t end = last - offset < width ? last : offset + width - 1;
+        ranges.push_back({
+            static_cast<int64_t>(static_cast<uint64_t>(lo) + offset),
+            static_cast<int64_t>(static_cast<uint64_t>(lo) + end)});
+        if (end == last)
+            break;
+    }
+    return ranges;
+}
+
+struct Scan {
+    std::vector<Range> ranges;
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> failed{false};
+
+    std::mutex mutex; // guards combine and result
+    ScanResult result;
+
+    void fail(int code, const std::string& msg)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!result.error())
+        {
+            result.error_code = code;
+            result.error_msg = msg;
+        }
+        failed = true;
+    }
+};
+
+void worker(Scan& scan, const std::string& db_path, const std::string& sql, const ScanCombiner& combine)
+{
+    auto db = Database::make_read_only(db_path);
+    if (!db->opened())
+        return scan.fail(SQLITE_CANTOPEN, db->error_msg());
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db->handle(), sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+        return scan.fail(sqlite3_errcode(db->handle()), sqlite3_errmsg(db->handle()));
+
+    int lo = sqlite3_bind_parameter_index(stmt, ":lo");
+    int hi = sqlite3_bind_parameter_index(stmt, ":hi");
+
+    for (std::size_t i; !scan.failed && (i = scan.next++) < scan.ranges.size(); )
+    {
+        sqlite3_bind_int64(stmt, lo, scan.ranges[i].lo);
+        sqlite3_bind_int64(stmt, hi, scan.ranges[i].hi);
+        auto rows = ResultCache::materialize(db->handle(), stmt);
+        sqlite3_reset(stmt);
+
+        if (rows->error())
+        {
+            scan.fail(rows->error_code(), rows->error_msg());
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(scan.mutex);
+        combine(i, *rows);
+        scan.result.partitions++;
+    }
+    sqlite3_finalize(stmt);
+}
+
+} // namespace
+
+ScanResult parallel_scan(
+        const std::string& db_path,
+        const std::string& table,
+        const std::string& sql_template,
+        std::size_t partitions,
+        const ScanCombiner& combine,
+        const ScanOptions& options)
+{
+    Scan scan;
+
+    auto db = Database::make_read_only(db_path);
+    if (!db->opened())
+    {
+        scan.result.error_code = SQLITE_CANTOPEN;
+        scan.result.error_msg = db->error_msg();
+        return scan.result;
+    }
+
+    auto bounds = db->query("SELECT min(\"" + options.key + "\"), max(\"" + options.key + "\") FROM \"" + table + "\"");
+    if (bounds->error())
+    {
+        scan.result.error_code = bounds->error_code();
+        scan.result.error_msg = bounds->error_msg();
+        return scan.result;
+    }
+    if ((*bounds)[0].is_null(1))
+        return scan.result;
+
+    scan.ranges = split((*bounds)[0].get<i64>(1), (*bounds)[0].get<i64>(2), std::max<std::size_t>(partitions, 1));
+
+    std::size_t threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, scan.ranges.size());
+
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < threads; t++)
+        pool.emplace_back(worker, std::ref(scan), std::cref(db_path), std::cref(sql_template), std::cref(combine));
+    worker(scan, db_path, sql_template, combine);
+    for (auto& thread : pool)
+        thread.join();
+
+    return scan.result;
+}
+
+} // namespace slight
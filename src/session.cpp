@@ -0,0 +1,169 @@
+#include "slight_session.h"
+#include "details.h"
+#include "sqlite3.h"
+
+#include <exception>
+
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+#define SLIGHT_SESSION 1
+#endif
+
+namespace slight {
+
+#ifdef SLIGHT_SESSION
+
+namespace {
+
+/// @brief Copy and free a buffer sqlite allocated.
+Changeset take(void* data, int size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    Changeset changes(bytes, bytes + size);
+    sqlite3_free(data);
+    return changes;
+}
+
+/// @brief What on_conflict() is called with: the handler, and whatever it
+///        threw, for apply_changeset() to rethrow once sqlite is done.
+struct Apply {
+    const ConflictHandler& handler;
+    std::exception_ptr thrown;
+};
+
+int on_conflict(void* context, int type, sqlite3_changeset_iter* iter)
+{
+    auto apply = static_cast<Apply*>(context);
+    if (!apply->handler)
+        return SQLITE_CHANGESET_ABORT;
+
+    Conflict conflict;
+    switch (type) {
+        case SQLITE_CHANGESET_DATA: conflict.type = Conflict::Type::data; break;
+        case SQLITE_CHANGESET_NOTFOUND: conflict.type = Conflict::Type::not_found; break;
+        case SQLITE_CHANGESET_CONFLICT: conflict.type = Conflict::Type::conflict; break;
+        case SQLITE_CHANGESET_FOREIGN_KEY: conflict.type = Conflict::Type::foreign_key; break;
+        default: conflict.type = Conflict::Type::constraint; break;
+    }
+
+    const char* table = nullptr;
+    int columns = 0, op = 0, indirect = 0;
+    sqlite3changeset_op(iter, &table, &columns, &op, &indirect);
+    conflict.table = table ? table : "";
+    conflict.op = op == SQLITE_INSERT ? ChangeOp::insert : op == SQLITE_UPDATE ? ChangeOp::update : ChangeOp::remove;
+
+    // an exception must not unwind through sqlite's frames
+    ConflictAction action;
+    try
+    {
+        action = apply->handler(conflict);
+    }
+    catch (...)
+    {
+        apply->thrown = std::current_exception();
+        return SQLITE_CHANGESET_ABORT;
+    }
+
+    switch (action) {
+        case ConflictAction::abort:
+            return SQLITE_CHANGESET_ABORT;
+        case ConflictAction::replace:
+            if (type == SQLITE_CHANGESET_DATA || type == SQLITE_CHANGESET_CONFLICT)
+                return SQLITE_CHANGESET_REPLACE;
+            return SQLITE_CHANGESET_OMIT;
+        default:
+            return SQLITE_CHANGESET_OMIT;
+    }
+}
+
+} // namespace
+
+Session::~Session() { sqlite3session_delete(handle); }
+
+bool Session::attach(const std::string& table)
+{
+    if (!handle)
+        return false;
+    int rc = sqlite3session_attach(handle, table.empty() ? nullptr : table.c_str());
+    if (rc != SQLITE_OK && !error())
+    {
+        errcode = rc;
+        errmsg = sqlite3_errstr(rc);
+    }
+    return rc == SQLITE_OK;
+}
+
+bool Session::empty() const { return !handle || sqlite3session_isempty(handle); }
+
+Changeset Session::changeset()
+{
+    int size = 0;
+    void* data = nullptr;
+    if (!handle || sqlite3session_changeset(handle, &size, &data) != SQLITE_OK)
+        return Changeset();
+    return take(data, size);
+}
+
+Changeset Session::patchset()
+{
+    int size = 0;
+    void* data = nullptr;
+    if (!handle || sqlite3session_patchset(handle, &size, &data) != SQLITE_OK)
+        return Changeset();
+    return take(data, size);
+}
+
+std::shared_ptr<Session> Database::start_session(const std::vector<std::string>& tables)
+{
+    auto session = std::shared_ptr<Session>(new Session());
+    int rc = sqlite3session_create(me->db, "main", &session->handle);
+    if (rc != SQLITE_OK)
+    {
+        session->errcode = rc;
+        session->errmsg = sqlite3_errmsg(me->db);
+        return session;
+    }
+
+    if (tables.empty())
+        session->attach(std::string());
+    for (const auto& table : tables)
+        session->attach(table);
+    return session;
+}
+
+bool Database::apply_changeset(const Changeset& changes, const ConflictHandler& on_conflict)
+{
+    Apply apply{on_conflict, nullptr};
+    int rc = sqlite3changeset_apply(
+        me->db,
+        static_cast<int>(changes.size()),
+        const_cast<unsigned char*>(changes.data()),
+        nullptr,
+        &slight::on_conflict,
+        &apply);
+    me->changes.after_commit(me->db);
+    if (apply.thrown)
+        std::rethrow_exception(apply.thrown);
+    return rc == SQLITE_OK;
+}
+
+#else
+
+Session::~Session() = default;
+bool Session::attach(const std::string&) { return false; }
+bool Session::empty() const { return true; }
+Changeset Session::changeset() { return Changeset(); }
+Changeset Session::patchset() { return Changeset(); }
+
+std::shared_ptr<Session> Database::start_session(const std::vector<std::string>&)
+{
+    auto session = std::shared_ptr<Session>(new Session());
+    session->errcode = SQLITE_ERROR;
+    session->errmsg = "sqlite was built without SQLITE_ENABLE_SESSION";
+    return session;
+}
+
+bool Database::apply_changeset(const Changeset&, const ConflictHandler&) { return false; }
+
+#endif // SLIGHT_SESSION
+
+} // namespace slight
@@ -0,0 +1,206 @@
+#include "slight_shard.h"
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <thread>
+
+namespace slight {
+
+namespace {
+
+std::unique_ptr<ShardedDatabase> make(
+        const std::string& path,
+        std::size_t shards,
+        std::unique_ptr<Database> (*open)(const std::string&))
+{
+    std::vector<std::unique_ptr<Database>> databases;
+    for (std::size_t i = 0; i < shards; i++)
+        databases.push_back(open(path + "." + std::to_string(i)));
+    return std::unique_ptr<ShardedDatabase>(new ShardedDatabase(std::move(databases)));
+}
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// FNV-1a
+uint64_t fnv1a(const std::string& key)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key)
+    {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/// @brief -1, 0 or 1 as a sorts before, with or after b.
+int compare(const ResultSet::Row& a, const ResultSet::Row& b, const MergeKey& key)
+{
+    bool a_null = a.is_null(key.column);
+    bool b_null = b.is_null(key.column);
+    if (a_null || b_null)
+        return b_null - a_null;
+
+    switch (key.type) {
+        case flt:
+        {
+            auto x = a.get<flt>(key.column);
+            auto y = b.get<flt>(key.column);
+            return (x > y) - (x < y);
+        }
+        case text:
+        {
+            auto x = a.get<text_view>(key.column);
+            auto y = b.get<text_view>(key.column);
+            int c = x.size && y.size ? std::memcmp(x.data, y.data, std::min(x.size, y.size)) : 0;
+            if (c == 0)
+                c = (x.size > y.size) - (x.size < y.size);
+            return (c > 0) - (c < 0);
+        }
+        default:
+        {
+            auto x = a.get<i64>(key.column);
+            auto y = b.get<i64>(key.column);
+            return (x > y) - (x < y);
+        }
+    }
+}
+
+/// @brief Run statement on every database, one thread each, without gathering rows.
+Gathered query_all(
+        const std::vector<std::unique_ptr<Database>>& databases,
+        const std::string& statement,
+        std::initializer_list<const Bind> binds)
+{
+    Gathered gathered;
+    gathered.shards.resize(databases.size());
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < databases.size(); i++)
+        threads.emplace_back([&, i] { gathered.shards[i] = databases[i]->query(statement, binds); });
+    if (!databases.empty())
+        gathered.shards[0] = databases[0]->query(statement, binds);
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& shard : gathered.shards)
+    {
+        if (shard->error())
+        {
+            gathered.error_code = shard->error_code();
+            gathered.error_msg = shard->error_msg();
+            break;
+        }
+    }
+    return gathered;
+}
+
+} // namespace
+
+ShardedDatabase::ShardedDatabase(std::vector<std::unique_ptr<Database>> shards)
+    : databases(std::move(shards))
+{
+    if (databases.empty())
+    {
+        errcode = SQLITE_MISUSE;
+        errmsg = "a sharded database needs at least one shard";
+    }
+}
+
+Gathered ShardedDatabase::failed() const
+{
+    Gathered gathered;
+    gathered.error_code = errcode;
+    gathered.error_msg = errmsg;
+    return gathered;
+}
+
+std::unique_ptr<ShardedDatabase> ShardedDatabase::make_read_only(const std::string& path, std::size_t shards)
+    { return make(path, shards, &Database::make_read_only); }
+std::unique_ptr<ShardedDatabase> ShardedDatabase::make_read_write(const std::string& path, std::size_t shards)
+    { return make(path, shards, &Database::make_read_write); }
+std::unique_ptr<ShardedDatabase> ShardedDatabase::make_create_read_write(const std::string& path, std::size_t shards)
+    { return make(path, shards, &Database::make_create_read_write); }
+
+bool ShardedDatabase::opened() const
+{
+    for (const auto& db : databases)
+        if (!db->opened())
+            return false;
+    return !databases.empty();
+}
+
+std::size_t ShardedDatabase::shard_for(int64_t key) const
+    { return error() ? 0 : mix(static_cast<uint64_t>(key)) % databases.size(); }
+std::size_t ShardedDatabase::shard_for(const std::string& key) const
+    { return error() ? 0 : mix(fnv1a(key)) % databases.size(); }
+
+std::shared_ptr<Statement> ShardedDatabase::prepare(int64_t key, const std::string& statement)
+    { return error() ? nullptr : databases[shard_for(key)]->prepare(statement); }
+std::shared_ptr<Statement> ShardedDatabase::prepare(const std::string& key, const std::string& statement)
+    { return error() ? nullptr : databases[shard_for(key)]->prepare(statement); }
+
+Gathered ShardedDatabase::scatter(const std::string& statement, std::initializer_list<const Bind> binds)
+{
+    if (error())
+        return failed();
+    auto gathered = query_all(databases, statement, binds);
+    if (gathered.error())
+        return gathered;
+
+    std::size_t rows = 0;
+    for (const auto& shard : gathered.shards)
+        rows += shard->size();
+    gathered.rows.reserve(rows);
+
+    for (const auto& shard : gathered.shards)
+        for (std::size_t r = 0; r < shard->size(); r++)
+            gathered.rows.push_back((*shard)[r]);
+    return gathered;
+}
+
+Gathered ShardedDatabase::scatter(const std::string& statement, const MergeKey& key, std::initializer_list<const Bind> binds)
+{
+    if (error())
+        return failed();
+    auto gathered = query_all(databases, statement, binds);
+    if (gathered.error())
+        return gathered;
+
+    // (shard, row) cursors, with the head that sorts first on top
+    typedef std::pair<std::size_t, std::size_t> Cursor;
+    const auto& shards = gathered.shards;
+    auto later = [&](const Cursor& a, const Cursor& b) {
+        int c = compare((*shards[a.first])[a.second], (*shards[b.first])[b.second], key);
+        if (key.descending)
+            c = -c;
+        return c != 0 ? c > 0 : a.first > b.first;
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+    for (std::size_t i = 0; i < shards.size(); i++)
+        if (!shards[i]->empty())
+            heads.emplace(i, 0);
+
+    while (!heads.empty())
+    {
+        auto head = heads.top();
+        heads.pop();
+        gathered.rows.push_back((*shards[head.first])[head.second]);
+        if (++head.second < shards[head.first]->size())
+            heads.push(head);
+    }
+    return gathered;
+}
+
+} // namespace slight
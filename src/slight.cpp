@@ -1,30 +1,20 @@
 #include "slight.h"
+#include "details.h"
+#include "busy.h"
+#include "cache.h"
+#include "carray.h"
+#include "vec.h"
+#include "vtab.h"
 #include "sqlite3.h"
 
 #include <cassert> // assert
+#include <cctype>  // isspace
+#include <chrono>
 #include <cstring> // strlen
 
 namespace slight {
 
-/// @brief Statement
-///
-/// @note This class is used to access the results of a database operation.
-///
-struct Statement::details {
-    details(sqlite3* db, std::string statement)
-        : statement(std::move(statement))
-        , sqlite_errcode(sqlite3_errcode(db))
-        , db(db)
-        , stmt() {}
-    ~details() { sqlite3_finalize(stmt); }
-
-    const std::string statement;
-
-    int sqlite_errcode;
-    std::string sqlite_errmsg;
-    sqlite3* db;
-    sqlite3_stmt* stmt;
-};
+Statement::~Statement() { delete me; }
 
 bool Statement::ready() const { return !(done() || error()); }
 bool Statement::has_row() const { return me->sqlite_errcode == SQLITE_ROW; }
@@ -40,19 +30,38 @@ int Statement::error_code() const { return me->sqlite_errcode; }
 const std::string& Statement::error_msg() const { return me->sqlite_errmsg; }
 std::string Statement::error_detail() const { return "\"" + me->statement + "\" - " + error_msg(); }
 
-int sqlite_bind(sqlite3_stmt* stmt, const Bind& bind, int index)
+int sqlite_bind(sqlite3_stmt* stmt, const Bind& bind, int index, uint64_t& bytes)
 {
     assert(index > 0);
     switch (bind.data_type) {
         case Bind::DataType::i32:
+            bytes += 8;
             return sqlite3_bind_int(stmt, index, bind.i);
         case Bind::DataType::i64:
         case Bind::DataType::u32:
+            bytes += 8;
             return sqlite3_bind_int64(stmt, index, bind.i);
         case Bind::DataType::flt:
+            bytes += 8;
             return sqlite3_bind_double(stmt, index, bind.f);
         case Bind::DataType::str:
-            return sqlite3_bind_text(stmt, index, bind.str, strlen(bind.str), nullptr);
+        {
+            auto size = strlen(bind.str);
+            bytes += size;
+            return sqlite3_bind_text(stmt, index, bind.str, size, nullptr);
+        }
+        case Bind::DataType::iso8601:
+        {
+            char str[iso8601_size];
+            auto size = format_iso8601(DateTime(std::chrono::microseconds(bind.i)), str);
+            bytes += size;
+            return sqlite3_bind_text(stmt, index, str, static_cast<int>(size), SQLITE_TRANSIENT);
+        }
+        case Bind::DataType::i64_array:
+        case Bind::DataType::flt_array:
+        case Bind::DataType::str_array:
+            bytes += 8 * bind.array.size;
+            return carray::bind(stmt, index, bind);
     }
 }
 
@@ -73,12 +82,17 @@ void Statement::bind(const Bind& b)
         index++;
     }
 
-    me->sqlite_errcode = sqlite_bind(me->stmt, b, index);
+    uint64_t bytes = 0;
+    me->sqlite_errcode = sqlite_bind(me->stmt, b, index, bytes);
+    me->database->metrics.add(MetricsRegistry::bytes_bound, bytes);
+    if (error())
+        me->database->metrics.error(me->sqlite_errcode);
 }
 
 void Statement::bind(std::initializer_list<const Bind>&& binds)
 {
     int index = 0;
+    uint64_t bytes = 0;
     for (auto b : binds)
     {
         if (error())
@@ -96,17 +110,52 @@ void Statement::bind(std::initializer_list<const Bind>&& binds)
                 break;
         }
 
-        sqlite_bind(me->stmt, b, index);
+        sqlite_bind(me->stmt, b, index, bytes);
     }
+    me->database->metrics.add(MetricsRegistry::bytes_bound, bytes);
 }
 
 bool Statement::step()
 {
     if (!error())
     {
+        auto busy = me->database->busy.get();
+        bool fresh = !sqlite3_stmt_busy(me->stmt);
+        if (busy)
+            busy->gave_up = false;
+
         me->sqlite_errcode = sqlite3_step(me->stmt);
+
+        // a read that hit SQLITE_BUSY before producing a row can be re-run as
+        // is, unless the busy handler already waited out the whole policy
+        if (busy && busy->policy.retry_reads && fresh && sqlite3_stmt_readonly(me->stmt)
+            && sqlite3_get_autocommit(me->db))
+        {
+            for (int count = 0; (me->sqlite_errcode & 0xff) == SQLITE_BUSY && !busy->gave_up; count++)
+            {
+                sqlite3_reset(me->stmt);
+                if (!busy->wait(count))
+                    break;
+                me->sqlite_errcode = sqlite3_step(me->stmt);
+            }
+        }
+
+        auto& metrics = me->database->metrics;
+        metrics.add(MetricsRegistry::steps);
+        if (me->bytes_read)
+        {
+            metrics.add(MetricsRegistry::bytes_read, me->bytes_read);
+            me->bytes_read = 0;
+        }
+        if (has_row())
+            metrics.add(MetricsRegistry::rows);
+        me->database->changes.after_commit(me->db);
+
         if (error())
+        {
             me->sqlite_errmsg = sqlite3_errmsg(me->db);
+            metrics.error(me->sqlite_errcode);
+        }
     }
 
     return has_row();
@@ -118,23 +167,117 @@ bool Statement::reset()
     return ready();
 }
 
+// get<> counts bytes read in the statement and leaves the atomic add to step()
+
 template<>
-Typer<i32>::Type Statement::get<i32>(int index) { return sqlite3_column_int(me->stmt, index - 1); }
+Typer<i32>::Type Statement::get<i32>(int index)
+{
+    me->bytes_read += 8;
+    return sqlite3_column_int(me->stmt, index - 1);
+}
 
 template<>
-Typer<i64>::Type Statement::get<i64>(int index) { return sqlite3_column_int64(me->stmt, index - 1); }
+Typer<i64>::Type Statement::get<i64>(int index)
+{
+    me->bytes_read += 8;
+    return sqlite3_column_int64(me->stmt, index - 1);
+}
 
 template<>
 Typer<u32>::Type Statement::get<u32>(int index)
-    { return static_cast<Typer<u32>::Type>(sqlite3_column_int64(me->stmt, index - 1)); }
+{
+    me->bytes_read += 8;
+    return static_cast<Typer<u32>::Type>(sqlite3_column_int64(me->stmt, index - 1));
+}
 
 template<>
 Typer<flt>::Type Statement::get<flt>(int index)
-    { return static_cast<Typer<flt>::Type>(sqlite3_column_double(me->stmt, index - 1)); }
+{
+    me->bytes_read += 8;
+    return static_cast<Typer<flt>::Type>(sqlite3_column_double(me->stmt, index - 1));
+}
 
 template<>
 Typer<text>::Type Statement::get<text>(int index)
-    { return reinterpret_cast<Typer<text>::Type>(sqlite3_column_text(me->stmt, index - 1)); }
+{
+    auto value = reinterpret_cast<Typer<text>::Type>(sqlite3_column_text(me->stmt, index - 1));
+    me->bytes_read += static_cast<uint64_t>(sqlite3_column_bytes(me->stmt, index - 1));
+    return value;
+}
+
+template<>
+Typer<text_view>::Type Statement::get<text_view>(int index)
+{
+    // text before bytes, so the length is that of the converted value
+    auto data = reinterpret_cast<const char*>(sqlite3_column_text(me->stmt, index - 1));
+    auto size = static_cast<std::size_t>(sqlite3_column_bytes(me->stmt, index - 1));
+    me->bytes_read += size;
+    return TextView{data, size};
+}
+
+ColumnType Statement::column_type(int index) const
+{
+    switch (sqlite3_column_type(me->stmt, index - 1)) {
+        case SQLITE_INTEGER: return i64;
+        case SQLITE_FLOAT: return flt;
+        case SQLITE_TEXT: return text;
+        case SQLITE_BLOB: return blob;
+        default: return nil;
+    }
+}
+
+void Statement::get_into(int index, std::string& out)
+{
+    auto view = get<text_view>(index);
+    out.assign(view.data ? view.data : "", view.size);
+}
+
+// integers are epoch micros and text is ISO-8601; anything else, including
+// text that does not parse, reads as the epoch
+
+template<>
+Typer<datetime>::Type Statement::get<datetime>(int index)
+{
+    DateTime value;
+    if (sqlite3_column_type(me->stmt, index - 1) == SQLITE_TEXT)
+    {
+        auto str = reinterpret_cast<const char*>(sqlite3_column_text(me->stmt, index - 1));
+        auto size = static_cast<std::size_t>(sqlite3_column_bytes(me->stmt, index - 1));
+        me->bytes_read += size;
+        parse_iso8601(str, size, value);
+        return value;
+    }
+    me->bytes_read += 8;
+    if (sqlite3_column_type(me->stmt, index - 1) == SQLITE_INTEGER)
+        value = DateTime(std::chrono::microseconds(sqlite3_column_int64(me->stmt, index - 1)));
+    return value;
+}
+
+namespace function_details {
+
+int64_t value_i64(sqlite3_value* value) { return sqlite3_value_int64(value); }
+double value_flt(sqlite3_value* value) { return sqlite3_value_double(value); }
+const char* value_text(sqlite3_value* value) { return reinterpret_cast<const char*>(sqlite3_value_text(value)); }
+Blob value_blob(sqlite3_value* value)
+{
+    auto data = sqlite3_value_blob(value);
+    return Blob{data, static_cast<std::size_t>(sqlite3_value_bytes(value))};
+}
+
+void result_null(sqlite3_context* ctx) { sqlite3_result_null(ctx); }
+void result_i64(sqlite3_context* ctx, int64_t value) { sqlite3_result_int64(ctx, value); }
+void result_flt(sqlite3_context* ctx, double value) { sqlite3_result_double(ctx, value); }
+void result_text(sqlite3_context* ctx, const char* value, std::size_t size)
+    { sqlite3_result_text64(ctx, value, size, SQLITE_TRANSIENT, SQLITE_UTF8); }
+void result_blob(sqlite3_context* ctx, const void* value, std::size_t size)
+    { sqlite3_result_blob64(ctx, value, size, SQLITE_TRANSIENT); }
+void result_error(sqlite3_context* ctx, const char* msg) { sqlite3_result_error(ctx, msg, -1); }
+void* user_data(sqlite3_context* ctx) { return sqlite3_user_data(ctx); }
+void* aggregate_context(sqlite3_context* ctx, std::size_t size)
+    { return sqlite3_aggregate_context(ctx, static_cast<int>(size)); }
+void result_nomem(sqlite3_context* ctx) { sqlite3_result_error_nomem(ctx); }
+
+} // namespace function_details
 
 Bind::Bind(int32_t i)
     : type(Type::empty)
@@ -206,26 +349,121 @@ Bind::Bind(const char* column, const char* str)
     , column(column)
     , data_type(DataType::str)
     , str(str) {}
+Bind::Bind(DateTime value, DateTimeFormat format)
+    : type(Type::empty)
+    , data_type(format == DateTimeFormat::iso8601 ? DataType::iso8601 : DataType::i64)
+    , i(value.time_since_epoch().count()) {}
+Bind::Bind(int index, DateTime value, DateTimeFormat format)
+    : type(Type::index)
+    , index(index)
+    , data_type(format == DateTimeFormat::iso8601 ? DataType::iso8601 : DataType::i64)
+    , i(value.time_since_epoch().count()) {}
+Bind::Bind(const char* column, DateTime value, DateTimeFormat format)
+    : type(Type::column)
+    , column(column)
+    , data_type(format == DateTimeFormat::iso8601 ? DataType::iso8601 : DataType::i64)
+    , i(value.time_since_epoch().count()) {}
+Bind::Bind(const std::vector<int64_t>& values)
+    : type(Type::empty)
+    , data_type(DataType::i64_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(const std::vector<double>& values)
+    : type(Type::empty)
+    , data_type(DataType::flt_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(const std::vector<std::string>& values)
+    : type(Type::empty)
+    , data_type(DataType::str_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(int index, const std::vector<int64_t>& values)
+    : type(Type::index)
+    , index(index)
+    , data_type(DataType::i64_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(int index, const std::vector<double>& values)
+    : type(Type::index)
+    , index(index)
+    , data_type(DataType::flt_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(int index, const std::vector<std::string>& values)
+    : type(Type::index)
+    , index(index)
+    , data_type(DataType::str_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(const char* column, const std::vector<int64_t>& values)
+    : type(Type::column)
+    , column(column)
+    , data_type(DataType::i64_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(const char* column, const std::vector<double>& values)
+    : type(Type::column)
+    , column(column)
+    , data_type(DataType::flt_array)
+    , array{values.data(), values.size()} {}
+Bind::Bind(const char* column, const std::vector<std::string>& values)
+    : type(Type::column)
+    , column(column)
+    , data_type(DataType::str_array)
+    , array{values.data(), values.size()} {}
+
+namespace {
+
+int on_commit(void* database)
+{
+    auto me = static_cast<Database::details*>(database);
+    me->metrics.add(MetricsRegistry::commits);
+    me->changes.on_commit();
+    return 0;
+}
+
+void on_rollback(void* database)
+{
+    auto me = static_cast<Database::details*>(database);
+    me->metrics.add(MetricsRegistry::rollbacks);
+    me->changes.on_rollback();
+}
 
-struct Database::details {
-    details(const std::string& path, int access)
+} // namespace
+
+Database::details::details(const std::string& path, int access)
+{
+    status.opened = sqlite3_open_v2(path.c_str(), &db, access, nullptr) == SQLITE_OK;
+    if (status.opened)
+        status.opened =
+            carray::register_module(db) == SQLITE_OK &&
+            vec::register_functions(db) == SQLITE_OK;
+    if (status.opened)
     {
-        status.opened = sqlite3_open_v2(path.c_str(), &db, access, nullptr) == SQLITE_OK;
-        if (!status.opened)
-            status.error_msg = sqlite3_errmsg(db);
-        else
-            // status.path = sqlite3_db_filename(db, path.c_str());
-            status.path = path;
+        sqlite3_commit_hook(db, &on_commit, this);
+        sqlite3_rollback_hook(db, &on_rollback, this);
     }
-    ~details() { sqlite3_close(db); }
+    if (!status.opened)
+        status.error_msg = sqlite3_errmsg(db);
+    else
+        // status.path = sqlite3_db_filename(db, path.c_str());
+        status.path = path;
+}
+
+Database::details::~details()
+{
+    cache.reset();
+    busy.reset();
+    // a statement still alive keeps the connection until it is finalized
+    sqlite3_close_v2(db);
+}
+
+Database::~Database() { delete me; }
 
-    sqlite3* db{nullptr};
-    struct {
-        bool opened{false};
-        std::string path;
-        std::string error_msg;
-    } status;
-};
+Database& Database::operator=(Database&& other)
+{
+    if (this != &other)
+    {
+        delete me;
+        me = other.me;
+        other.me = nullptr;
+    }
+    return *this;
+}
 
 Database open(const std::string& path, int access)
 {
@@ -258,13 +496,18 @@ std::shared_ptr<Statement> Database::prepare(const std::string& statement)
     assert(!statement.empty());
 
     auto stmt_details = new Statement::details(me->db, statement);
+    stmt_details->database = me;
 
     stmt_details->sqlite_errcode =
             sqlite3_prepare_v3(me->db, statement.c_str(), statement.size(), 0, &stmt_details->stmt, nullptr);
 
     auto stmt = new Statement(stmt_details);
+    me->metrics.add(MetricsRegistry::prepares);
     if (stmt->error())
+    {
         stmt_details->sqlite_errmsg = sqlite3_errmsg(me->db);
+        me->metrics.error(stmt_details->sqlite_errcode);
+    }
 
     return std::shared_ptr<Statement>(stmt);
 }
@@ -289,8 +532,246 @@ std::shared_ptr<Statement> Database::set_schema_version(SchemaVersion version)
     return stmt;
 }
 
+bool Database::create_function(
+    const std::string& name,
+    int n_args,
+    bool deterministic,
+    void* state,
+    ScalarFunction function,
+    void (*destroy)(void*))
+{
+    int flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+    return sqlite3_create_function_v2(
+        me->db, name.c_str(), n_args, flags, state, function, nullptr, nullptr, destroy) == SQLITE_OK;
+}
+
+bool Database::create_aggregate(
+    const std::string& name,
+    int n_args,
+    bool deterministic,
+    void* state,
+    ScalarFunction step,
+    FinalFunction final,
+    FinalFunction value,
+    ScalarFunction inverse,
+    void (*destroy)(void*))
+{
+    int flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+    return sqlite3_create_window_function(
+        me->db, name.c_str(), n_args, flags, state, step, final, value, inverse, destroy) == SQLITE_OK;
+}
+
+bool Database::create_module(const std::string& name, vtab_details::Table* table)
+{
+    return vtab::register_module(me->db, name, table) == SQLITE_OK;
+}
+
+void Database::enable_result_cache(std::size_t max_bytes)
+{
+    me->cache.reset(new ResultCache(me->db, max_bytes));
+}
+
+void Database::disable_result_cache() { me->cache.reset(); }
+
+void Database::set_busy_policy(const BusyPolicy& policy)
+{
+    me->busy.reset();
+    me->busy.reset(new BusyHandler(me->db, policy, me->metrics));
+}
+
+void Database::clear_busy_policy() { me->busy.reset(); }
+
+BusyStats Database::busy_stats() const { return me->busy ? me->busy->stats : BusyStats(); }
+
+ResultCacheStats Database::result_cache_stats() const
+{
+    return me->cache ? me->cache->stats : ResultCacheStats();
+}
+
+std::shared_ptr<const ResultSet> Database::query(const std::string& sql, std::initializer_list<const Bind> binds)
+{
+    std::string key;
+    if (me->cache)
+    {
+        me->cache->validate();
+        key = ResultCache::key(sql, binds);
+        if (auto hit = me->cache->find(key))
+        {
+            me->metrics.add(MetricsRegistry::result_cache_hits);
+            return hit;
+        }
+    }
+
+    auto stmt = prepare(sql);
+    std::shared_ptr<ResultSet> result;
+    if (stmt->error())
+    {
+        result = std::make_shared<ResultSet>();
+        result->errcode = stmt->error_code();
+        result->errmsg = stmt->error_msg();
+        return result;
+    }
+
+    stmt->bind(std::move(binds));
+    result = ResultCache::materialize(me->db, stmt->me->stmt, &me->metrics);
+    me->changes.after_commit(me->db);
+
+    if (me->cache && !result->error() && sqlite3_stmt_readonly(stmt->me->stmt))
+    {
+        // query() itself must not count as a change, nor can a read-only
+        // statement make one, so the snapshot taken above is still current
+        me->cache->insert(key, result);
+    }
+    return result;
+}
+
+ScriptResult Database::execute_script(const char* sql, std::size_t size, bool transaction)
+{
+    ScriptResult result;
+    auto fail = [&](int rc) {
+        result.error_code = rc;
+        result.error_msg = sqlite3_errmsg(me->db);
+        me->metrics.error(rc);
+    };
+
+    if (transaction && sqlite3_exec(me->db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        fail(sqlite3_errcode(me->db));
+        return result;
+    }
+
+    const char* end = sql + size;
+    for (const char* next = sql; next < end; )
+    {
+        if (std::isspace(static_cast<unsigned char>(*next)))
+        {
+            next++;
+            continue;
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        sqlite3_stmt* stmt = nullptr;
+        const char* tail = next;
+        int rc = sqlite3_prepare_v3(me->db, next, static_cast<int>(end - next), 0, &stmt, &tail);
+        if (!tail || tail < next)
+            tail = next;
+
+        if (rc == SQLITE_OK && !stmt) // whitespace, comments or a stray ';'
+        {
+            if (tail == next)
+                break;
+            next = tail;
+            continue;
+        }
+
+        me->metrics.add(MetricsRegistry::prepares);
+        ScriptResult::Statement record{static_cast<std::size_t>(next - sql), static_cast<std::size_t>(tail - next), 0, {}};
+
+        if (rc == SQLITE_OK)
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+                record.rows++;
+        me->metrics.add(MetricsRegistry::steps, record.rows + 1);
+        me->metrics.add(MetricsRegistry::rows, record.rows);
+        sqlite3_finalize(stmt);
+        me->changes.after_commit(me->db);
+
+        record.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started);
+        result.statements.push_back(record);
+
+        if (rc != SQLITE_DONE)
+        {
+            fail(rc);
+            break;
+        }
+        next = tail;
+    }
+
+    if (transaction)
+    {
+        if (!result.error() && sqlite3_exec(me->db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK)
+            fail(sqlite3_errcode(me->db));
+        if (result.error() && !sqlite3_get_autocommit(me->db))
+            sqlite3_exec(me->db, "ROLLBACK", nullptr, nullptr, nullptr);
+        me->changes.after_commit(me->db);
+    }
+    return result;
+}
+
+Snapshot::~Snapshot()
+{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    sqlite3_snapshot_free(handle);
+#endif
+}
+
+int Snapshot::compare(const Snapshot& other) const
+{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (handle && other.handle)
+        return sqlite3_snapshot_cmp(handle, other.handle);
+#endif
+    (void)other;
+    return 0;
+}
+
+std::shared_ptr<Snapshot> Database::snapshot()
+{
+    auto snapshot = std::shared_ptr<Snapshot>(new Snapshot());
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    int rc = SQLITE_OK;
+    bool began = sqlite3_get_autocommit(me->db) != 0;
+    if (began)
+        rc = sqlite3_exec(me->db, "BEGIN; SELECT 1 FROM sqlite_master LIMIT 1", nullptr, nullptr, nullptr);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_snapshot_get(me->db, "main", &snapshot->handle);
+    if (rc != SQLITE_OK)
+    {
+        snapshot->errcode = rc;
+        snapshot->errmsg = sqlite3_errmsg(me->db);
+        // don't leave the transaction we opened for later writes to land in
+        if (began && !sqlite3_get_autocommit(me->db))
+            sqlite3_exec(me->db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+#else
+    snapshot->errcode = SQLITE_ERROR;
+    snapshot->errmsg = "sqlite was built without SQLITE_ENABLE_SNAPSHOT";
+#endif
+    return snapshot;
+}
+
+bool Database::open_snapshot(const Snapshot& snapshot)
+{
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (!snapshot.handle || !sqlite3_get_autocommit(me->db))
+        return false;
+
+    // sqlite3_snapshot_open needs the pager to have opened the WAL already,
+    // which a connection that has never read anything has not
+    if (sqlite3_exec(me->db, "SELECT 1 FROM sqlite_master LIMIT 1; BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK)
+        return false;
+    if (sqlite3_snapshot_open(me->db, "main", snapshot.handle) != SQLITE_OK)
+    {
+        sqlite3_exec(me->db, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+#else
+    (void)snapshot;
+    return false;
+#endif
+}
+
+void Database::end_read()
+{
+    if (!sqlite3_get_autocommit(me->db))
+        sqlite3_exec(me->db, "COMMIT", nullptr, nullptr, nullptr);
+    me->changes.after_commit(me->db);
+}
+
 const std::string& Database::path() const { return me->status.path; }
 bool Database::opened() const { return me->status.opened; }
 const std::string& Database::error_msg() const { return me->status.error_msg; }
+sqlite3* Database::handle() const { return me->db; }
 
 } // namespace slight
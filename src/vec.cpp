@@ -0,0 +1,357 @@
+#include "slight_vec.h"
+#include "slight.h"
+#include "vec.h"
+#include "sqlite3.h"
+
+#include <algorithm> // push_heap, pop_heap, sort_heap
+#include <cmath>     // sqrt
+#include <cstring>   // memcpy
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SLIGHT_VEC_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SLIGHT_VEC_NEON
+#include <arm_neon.h>
+#endif
+
+namespace slight {
+namespace vec {
+
+namespace {
+
+/// @brief Squared norms and dot product, everything cosine similarity needs.
+struct Moments {
+    float ab;
+    float aa;
+    float bb;
+};
+
+// blobs handed out by sqlite have no alignment guarantee
+inline float load(const float* p)
+{
+    float f;
+    std::memcpy(&f, p, sizeof(f));
+    return f;
+}
+
+float dot_scalar(const float* a, const float* b, std::size_t n)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        s0 += load(a + i + 0) * load(b + i + 0);
+        s1 += load(a + i + 1) * load(b + i + 1);
+        s2 += load(a + i + 2) * load(b + i + 2);
+        s3 += load(a + i + 3) * load(b + i + 3);
+    }
+    for (; i < n; i++)
+        s0 += load(a + i) * load(b + i);
+    return (s0 + s1) + (s2 + s3);
+}
+
+float l2sq_scalar(const float* a, const float* b, std::size_t n)
+{
+    float s0 = 0, s1 = 0;
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        float d0 = load(a + i) - load(b + i);
+        float d1 = load(a + i + 1) - load(b + i + 1);
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+    }
+    for (; i < n; i++)
+    {
+        float d = load(a + i) - load(b + i);
+        s0 += d * d;
+    }
+    return s0 + s1;
+}
+
+Moments moments_scalar(const float* a, const float* b, std::size_t n)
+{
+    Moments m{0, 0, 0};
+    for (std::size_t i = 0; i < n; i++)
+    {
+        float x = load(a + i);
+        float y = load(b + i);
+        m.ab += x * y;
+        m.aa += x * x;
+        m.bb += y * y;
+    }
+    return m;
+}
+
+#ifdef SLIGHT_VEC_X86
+
+__attribute__((target("sse2")))
+inline float hsum(__m128 v)
+{
+    __m128 high = _mm_movehl_ps(v, v);
+    __m128 sums = _mm_add_ps(v, high);
+    high = _mm_shuffle_ps(sums, sums, 0x1);
+    return _mm_cvtss_f32(_mm_add_ss(sums, high));
+}
+
+__attribute__((target("sse2")))
+float dot_sse(const float* a, const float* b, std::size_t n)
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    return hsum(_mm_add_ps(s0, s1)) + dot_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+float l2sq_sse(const float* a, const float* b, std::size_t n)
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        s0 = _mm_add_ps(s0, _mm_mul_ps(d0, d0));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(d1, d1));
+    }
+    return hsum(_mm_add_ps(s0, s1)) + l2sq_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+Moments moments_sse(const float* a, const float* b, std::size_t n)
+{
+    __m128 ab = _mm_setzero_ps(), aa = _mm_setzero_ps(), bb = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(a + i);
+        __m128 y = _mm_loadu_ps(b + i);
+        ab = _mm_add_ps(ab, _mm_mul_ps(x, y));
+        aa = _mm_add_ps(aa, _mm_mul_ps(x, x));
+        bb = _mm_add_ps(bb, _mm_mul_ps(y, y));
+    }
+    Moments tail = moments_scalar(a + i, b + i, n - i);
+    return Moments{hsum(ab) + tail.ab, hsum(aa) + tail.aa, hsum(bb) + tail.bb};
+}
+
+__attribute__((target("avx2,fma")))
+inline float hsum(__m256 v)
+{
+    return hsum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+float dot_avx2(const float* a, const float* b, std::size_t n)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i +  0), _mm256_loadu_ps(b + i +  0), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i +  8), _mm256_loadu_ps(b + i +  8), s1);
+        s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), s2);
+        s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), s3);
+    }
+    for (; i + 8 <= n; i += 8)
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+    __m256 sum = _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3));
+    return hsum(sum) + dot_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+float l2sq_avx2(const float* a, const float* b, std::size_t n)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        s0 = _mm256_fmadd_ps(d0, d0, s0);
+        s1 = _mm256_fmadd_ps(d1, d1, s1);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        s0 = _mm256_fmadd_ps(d, d, s0);
+    }
+    return hsum(_mm256_add_ps(s0, s1)) + l2sq_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+Moments moments_avx2(const float* a, const float* b, std::size_t n)
+{
+    __m256 ab = _mm256_setzero_ps(), aa = _mm256_setzero_ps(), bb = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(a + i);
+        __m256 y = _mm256_loadu_ps(b + i);
+        ab = _mm256_fmadd_ps(x, y, ab);
+        aa = _mm256_fmadd_ps(x, x, aa);
+        bb = _mm256_fmadd_ps(y, y, bb);
+    }
+    Moments tail = moments_scalar(a + i, b + i, n - i);
+    return Moments{hsum(ab) + tail.ab, hsum(aa) + tail.aa, hsum(bb) + tail.bb};
+}
+
+#endif // SLIGHT_VEC_X86
+
+#ifdef SLIGHT_VEC_NEON
+
+float dot_neon(const float* a, const float* b, std::size_t n)
+{
+    float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        s0 = vfmaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+        s1 = vfmaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    return vaddvq_f32(vaddq_f32(s0, s1)) + dot_scalar(a + i, b + i, n - i);
+}
+
+float l2sq_neon(const float* a, const float* b, std::size_t n)
+{
+    float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        s0 = vfmaq_f32(s0, d0, d0);
+        s1 = vfmaq_f32(s1, d1, d1);
+    }
+    return vaddvq_f32(vaddq_f32(s0, s1)) + l2sq_scalar(a + i, b + i, n - i);
+}
+
+Moments moments_neon(const float* a, const float* b, std::size_t n)
+{
+    float32x4_t ab = vdupq_n_f32(0), aa = vdupq_n_f32(0), bb = vdupq_n_f32(0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t x = vld1q_f32(a + i);
+        float32x4_t y = vld1q_f32(b + i);
+        ab = vfmaq_f32(ab, x, y);
+        aa = vfmaq_f32(aa, x, x);
+        bb = vfmaq_f32(bb, y, y);
+    }
+    Moments tail = moments_scalar(a + i, b + i, n - i);
+    return Moments{vaddvq_f32(ab) + tail.ab, vaddvq_f32(aa) + tail.aa, vaddvq_f32(bb) + tail.bb};
+}
+
+#endif // SLIGHT_VEC_NEON
+
+struct Kernels {
+    const char* isa;
+    float (*dot)(const float*, const float*, std::size_t);
+    float (*l2sq)(const float*, const float*, std::size_t);
+    Moments (*moments)(const float*, const float*, std::size_t);
+};
+
+Kernels detect()
+{
+#if defined(SLIGHT_VEC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return Kernels{"avx2", dot_avx2, l2sq_avx2, moments_avx2};
+    if (__builtin_cpu_supports("sse2"))
+        return Kernels{"sse", dot_sse, l2sq_sse, moments_sse};
+#elif defined(SLIGHT_VEC_NEON)
+    return Kernels{"neon", dot_neon, l2sq_neon, moments_neon};
+#endif
+    return Kernels{"scalar", dot_scalar, l2sq_scalar, moments_scalar};
+}
+
+const Kernels& kernels()
+{
+    static const Kernels active = detect();
+    return active;
+}
+
+template<float (*kernel)(const float*, const float*, std::size_t)>
+void sql_function(sqlite3_context* ctx, int, sqlite3_value** argv)
+{
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL)
+        return sqlite3_result_null(ctx);
+
+    auto a = static_cast<const float*>(sqlite3_value_blob(argv[0]));
+    auto a_bytes = sqlite3_value_bytes(argv[0]);
+    auto b = static_cast<const float*>(sqlite3_value_blob(argv[1]));
+    auto b_bytes = sqlite3_value_bytes(argv[1]);
+
+    if (a_bytes != b_bytes || a_bytes % sizeof(float) != 0)
+        return sqlite3_result_error(ctx, "vectors must be float32 blobs of equal length", -1);
+
+    sqlite3_result_double(ctx, kernel(a, b, a_bytes / sizeof(float)));
+}
+
+} // namespace
+
+float dot(const float* a, const float* b, std::size_t n) { return kernels().dot(a, b, n); }
+
+float cosine(const float* a, const float* b, std::size_t n)
+{
+    auto m = kernels().moments(a, b, n);
+    if (m.aa == 0 || m.bb == 0)
+        return 0;
+    return m.ab / (std::sqrt(m.aa) * std::sqrt(m.bb));
+}
+
+float l2(const float* a, const float* b, std::size_t n) { return std::sqrt(kernels().l2sq(a, b, n)); }
+
+const char* isa() { return kernels().isa; }
+
+std::vector<Match> top_k(Statement& stmt, std::size_t k, Order order)
+{
+    // the heap keeps the worst of the current best k on top
+    auto better = [order](const Match& a, const Match& b) {
+        return order == Order::largest ? a.score > b.score : a.score < b.score;
+    };
+
+    std::vector<Match> heap;
+    heap.reserve(k);
+    if (k == 0)
+        return heap;
+
+    while (stmt.step())
+    {
+        Match match{stmt.get<i64>(1), stmt.get<flt>(2)};
+        if (heap.size() < k)
+        {
+            heap.push_back(match);
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+        else if (better(match, heap.front()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = match;
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), better);
+    return heap;
+}
+
+int register_functions(sqlite3* db)
+{
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+    int rc = sqlite3_create_function_v2(db, "vec_dot", 2, flags, nullptr, sql_function<dot>, nullptr, nullptr, nullptr);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function_v2(db, "vec_cosine", 2, flags, nullptr, sql_function<cosine>, nullptr, nullptr, nullptr);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function_v2(db, "vec_l2", 2, flags, nullptr, sql_function<l2>, nullptr, nullptr, nullptr);
+    return rc;
+}
+
+} // namespace vec
+} // namespace slight
@@ -0,0 +1,15 @@
+#ifndef SLIGHT_VEC_FUNCTIONS_H
+#define SLIGHT_VEC_FUNCTIONS_H
+
+struct sqlite3;
+
+namespace slight {
+namespace vec {
+
+/// @brief Register vec_dot, vec_cosine and vec_l2 on a connection.
+int register_functions(sqlite3* db);
+
+} // namespace vec
+} // namespace slight
+
+#endif // SLIGHT_VEC_FUNCTIONS_H
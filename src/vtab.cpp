@@ -0,0 +1,320 @@
+#include "vtab.h"
+#include "sqlite3.h"
+
+#include <cmath>   // log2
+#include <cstring> // memcmp
+
+namespace slight {
+namespace vtab {
+
+namespace {
+
+using vtab_details::Kind;
+using vtab_details::Table;
+using vtab_details::Value;
+
+// idxNum bits describing which key constraints were handed to xFilter
+enum Plan { eq = 1, gt = 2, ge = 4, lt = 8, le = 16 };
+
+// how sqlite converts a value compared against the key column
+enum class Affinity { none, numeric, text };
+
+struct VTable {
+    sqlite3_vtab base;
+    const Table* table;
+    int key;
+    Affinity affinity;
+};
+
+/// @brief Affinity of a column declared by declared_type().
+Affinity affinity_of(const char* type)
+{
+    if (std::strcmp(type, "INTEGER") == 0 || std::strcmp(type, "REAL") == 0)
+        return Affinity::numeric;
+    if (std::strcmp(type, "TEXT") == 0)
+        return Affinity::text;
+    return Affinity::none;
+}
+
+struct Cursor {
+    sqlite3_vtab_cursor base;
+    std::size_t row;
+    std::size_t end;
+};
+
+const Table& table_of(sqlite3_vtab* vtab) { return *reinterpret_cast<VTable*>(vtab)->table; }
+
+/// @brief Order a cell against a sqlite value the way sqlite's BINARY
+///        collation would: NULL < numbers < text.
+///
+/// @note Numeric probes of a text key compare as their text, as text
+///       affinity would convert them; numeric affinity is applied to the
+///       probes of numeric keys in x_filter.
+int compare(const Value& cell, sqlite3_value* value, Affinity affinity)
+{
+    auto rank = [](int type) { return type == SQLITE_NULL ? 0 : type == SQLITE_TEXT || type == SQLITE_BLOB ? 2 : 1; };
+    int type = sqlite3_value_type(value);
+    bool as_text = affinity == Affinity::text && (type == SQLITE_INTEGER || type == SQLITE_FLOAT);
+    if (as_text)
+        type = SQLITE_TEXT;
+    int cell_rank = cell.kind == Kind::null ? 0 : cell.kind == Kind::text ? 2 : 1;
+    if (cell_rank != rank(type))
+        return cell_rank < rank(type) ? -1 : 1;
+
+    switch (cell.kind) {
+        case Kind::null:
+            return 0;
+        case Kind::integer:
+            if (type == SQLITE_INTEGER)
+            {
+                auto i = sqlite3_value_int64(value);
+                return cell.i < i ? -1 : cell.i > i;
+            }
+            else
+            {
+                auto f = sqlite3_value_double(value);
+                return static_cast<double>(cell.i) < f ? -1 : static_cast<double>(cell.i) > f;
+            }
+        case Kind::real:
+        {
+            auto f = sqlite3_value_double(value);
+            return cell.f < f ? -1 : cell.f > f;
+        }
+        case Kind::text:
+        {
+            const void* str = as_text ? sqlite3_value_text(value) : sqlite3_value_blob(value);
+            auto size = static_cast<std::size_t>(sqlite3_value_bytes(value));
+            int c = std::memcmp(cell.str, str, cell.size < size ? cell.size : size);
+            return c != 0 ? c : cell.size < size ? -1 : cell.size > size;
+        }
+    }
+    return 0;
+}
+
+/// @brief First row in [begin, end) whose key is not less than value
+///        (or, with after, greater than value).
+std::size_t bound(const VTable& v, std::size_t begin, std::size_t end, sqlite3_value* value, bool after)
+{
+    const auto& table = *v.table;
+    const auto& get = table.columns[v.key].get;
+    while (begin < end)
+    {
+        std::size_t mid = begin + (end - begin) / 2;
+        int c = compare(get(table.row(mid)), value, v.affinity);
+        if (c < 0 || (after && c == 0))
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+    return begin;
+}
+
+int x_connect(sqlite3* db, void* aux, int, const char* const*, sqlite3_vtab** vtab, char**)
+{
+    auto table = static_cast<const Table*>(aux);
+
+    int key = -1;
+    std::string schema = "CREATE TABLE x(";
+    for (std::size_t i = 0; i < table->columns.size(); i++)
+    {
+        const auto& column = table->columns[i];
+        if (i > 0)
+            schema += ", ";
+        schema += "\"" + column.name + "\" " + column.type;
+        if (column.key && key < 0)
+            key = static_cast<int>(i);
+    }
+    schema += ")";
+
+    int rc = sqlite3_declare_vtab(db, schema.c_str());
+    if (rc == SQLITE_OK)
+    {
+        auto v = new VTable();
+        v->table = table;
+        v->key = key;
+        v->affinity = key >= 0 ? affinity_of(table->columns[key].type) : Affinity::none;
+        *vtab = &v->base;
+    }
+    return rc;
+}
+
+int x_disconnect(sqlite3_vtab* vtab)
+{
+    delete reinterpret_cast<VTable*>(vtab);
+    return SQLITE_OK;
+}
+
+int x_best_index(sqlite3_vtab* vtab, sqlite3_index_info* info)
+{
+    auto v = reinterpret_cast<VTable*>(vtab);
+    double rows = static_cast<double>(v->table->size());
+
+    // constraint feeding each plan bit, handed to xFilter in bit order
+    const int ops[] = {
+        SQLITE_INDEX_CONSTRAINT_EQ,
+        SQLITE_INDEX_CONSTRAINT_GT,
+        SQLITE_INDEX_CONSTRAINT_GE,
+        SQLITE_INDEX_CONSTRAINT_LT,
+        SQLITE_INDEX_CONSTRAINT_LE,
+    };
+    int plan = 0;
+    int argc = 0;
+    for (int op = 0; op < 5 && v->key >= 0; op++)
+    {
+        for (int i = 0; i < info->nConstraint; i++)
+        {
+            const auto& constraint = info->aConstraint[i];
+            if (!constraint.usable || constraint.iColumn != v->key || constraint.op != ops[op])
+                continue;
+            // the rows are in BINARY order, other collations are left to sqlite
+            if (v->affinity == Affinity::text && sqlite3_stricmp(sqlite3_vtab_collation(info, i), "BINARY") != 0)
+                continue;
+            plan |= 1 << op;
+            info->aConstraintUsage[i].argvIndex = ++argc;
+            break;
+        }
+    }
+
+    double probe = std::log2(rows + 1) + 1;
+    if (plan & eq)
+    {
+        info->estimatedCost = probe;
+        info->estimatedRows = 1;
+    }
+    else if (plan)
+    {
+        info->estimatedCost = probe + rows / ((plan & (gt | ge)) && (plan & (lt | le)) ? 16 : 4);
+        info->estimatedRows = static_cast<sqlite3_int64>(rows / 4) + 1;
+    }
+    else
+    {
+        info->estimatedCost = rows + 1;
+        info->estimatedRows = static_cast<sqlite3_int64>(rows);
+    }
+    info->idxNum = plan;
+
+    if (info->nOrderBy == 1 && info->aOrderBy[0].iColumn == v->key && !info->aOrderBy[0].desc)
+        info->orderByConsumed = 1;
+
+    return SQLITE_OK;
+}
+
+int x_open(sqlite3_vtab*, sqlite3_vtab_cursor** cursor)
+{
+    *cursor = &(new Cursor())->base;
+    return SQLITE_OK;
+}
+
+int x_close(sqlite3_vtab_cursor* cursor)
+{
+    delete reinterpret_cast<Cursor*>(cursor);
+    return SQLITE_OK;
+}
+
+int x_filter(sqlite3_vtab_cursor* base, int plan, const char*, int argc, sqlite3_value** argv)
+{
+    auto cursor = reinterpret_cast<Cursor*>(base);
+    auto v = reinterpret_cast<VTable*>(base->pVtab);
+    const auto& table = *v->table;
+
+    std::size_t begin = 0;
+    std::size_t end = table.size();
+    int arg = 0;
+
+    // e.g. id = '5' on an INTEGER key matches 5, as sqlite's own check will
+    if (v->affinity == Affinity::numeric)
+        for (int i = 0; i < argc; i++)
+            sqlite3_value_numeric_type(argv[i]);
+
+    // constraints are re-checked by sqlite, the bounds only narrow the scan
+    if (plan & eq)
+    {
+        begin = bound(*v, begin, end, argv[arg], false);
+        end = bound(*v, begin, end, argv[arg], true);
+        arg++;
+    }
+    if (plan & gt)
+        begin = bound(*v, begin, end, argv[arg++], true);
+    if (plan & ge)
+        begin = bound(*v, begin, end, argv[arg++], false);
+    if (plan & lt)
+        end = bound(*v, begin, end, argv[arg++], false);
+    if (plan & le)
+        end = bound(*v, begin, end, argv[arg++], true);
+
+    cursor->row = begin;
+    cursor->end = end < begin ? begin : end;
+    return SQLITE_OK;
+}
+
+int x_next(sqlite3_vtab_cursor* base)
+{
+    reinterpret_cast<Cursor*>(base)->row++;
+    return SQLITE_OK;
+}
+
+int x_eof(sqlite3_vtab_cursor* base)
+{
+    auto cursor = reinterpret_cast<Cursor*>(base);
+    return cursor->row >= cursor->end;
+}
+
+int x_column(sqlite3_vtab_cursor* base, sqlite3_context* ctx, int column)
+{
+    auto cursor = reinterpret_cast<Cursor*>(base);
+    const auto& table = table_of(base->pVtab);
+
+    auto value = table.columns[column].get(table.row(cursor->row));
+    switch (value.kind) {
+        case Kind::null:
+            sqlite3_result_null(ctx);
+            break;
+        case Kind::integer:
+            sqlite3_result_int64(ctx, value.i);
+            break;
+        case Kind::real:
+            sqlite3_result_double(ctx, value.f);
+            break;
+        case Kind::text:
+            sqlite3_result_text64(ctx, value.str, value.size, SQLITE_STATIC, SQLITE_UTF8);
+            break;
+    }
+    return SQLITE_OK;
+}
+
+int x_rowid(sqlite3_vtab_cursor* base, sqlite3_int64* rowid)
+{
+    *rowid = static_cast<sqlite3_int64>(reinterpret_cast<Cursor*>(base)->row) + 1;
+    return SQLITE_OK;
+}
+
+void destroy(void* table) { delete static_cast<Table*>(table); }
+
+// eponymous-only: xCreate, like every field not set here, stays null
+sqlite3_module make_module()
+{
+    sqlite3_module m = {};
+    m.xConnect = x_connect;
+    m.xBestIndex = x_best_index;
+    m.xDisconnect = x_disconnect;
+    m.xOpen = x_open;
+    m.xClose = x_close;
+    m.xFilter = x_filter;
+    m.xNext = x_next;
+    m.xEof = x_eof;
+    m.xColumn = x_column;
+    m.xRowid = x_rowid;
+    return m;
+}
+
+const sqlite3_module module = make_module();
+
+} // namespace
+
+int register_module(sqlite3* db, const std::string& name, Table* table)
+{
+    return sqlite3_create_module_v2(db, name.c_str(), &module, table, destroy);
+}
+
+} // namespace vtab
+} // namespace slight
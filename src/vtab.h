@@ -0,0 +1,21 @@
+#ifndef SLIGHT_VTAB_H
+#define SLIGHT_VTAB_H
+
+#include "slight.h"
+
+#include <string>
+
+struct sqlite3;
+
+namespace slight {
+namespace vtab {
+
+/// @brief Register table as an eponymous-only, read-only virtual table.
+///
+/// @note The connection takes ownership of table.
+int register_module(sqlite3* db, const std::string& name, vtab_details::Table* table);
+
+} // namespace vtab
+} // namespace slight
+
+#endif // SLIGHT_VTAB_H
@@ -1,9 +1,25 @@
 #include <gtest/gtest.h>
 #include <slight.h>
+#include <slight_cache.h>
+#include <slight_csv.h>
+#include <slight_fts.h>
+#include <slight_json.h>
+#include <slight_prefetch.h>
+#include <slight_queue.h>
+#include <slight_rtree.h>
+#include <slight_scan.h>
+#include <slight_session.h>
+#include <slight_shard.h>
+#include <slight_vec.h>
 #include <sqlite3.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <memory>
+#include <sstream>
+#include <thread>
 
 using slight::Bind;
 
@@ -41,6 +57,8 @@ public:
         : db()
     {
         remove("tests.db");
+        remove("tests.db-wal");
+        remove("tests.db-shm");
         db = slight::Database::make_create_read_write("tests.db");
 
         auto create = db->prepare(
@@ -640,3 +658,1614 @@ TEST_F(TestSlight, bind_column_null)
     EXPECT_EQ(bind.str, nullptr);
     EXPECT_EQ(bind.column, nullptr);
 }
+
+TEST_F(TestSlight, carray_i64)
+{
+    std::vector<int64_t> ids{1, 3, 5};
+    auto select = db->prepare("SELECT name FROM test WHERE id IN carray(?) ORDER BY id");
+    select->bind({Bind(ids)});
+    check(*select);
+
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "name1");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "name3");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "future proof");
+    select->step();
+    EXPECT_TRUE(select->done());
+}
+
+TEST_F(TestSlight, carray_reuse_statement)
+{
+    auto select = db->prepare("SELECT count(*) FROM test WHERE id IN carray(?)");
+
+    std::vector<int64_t> one{2};
+    select->bind(Bind(one));
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 1);
+
+    std::vector<int64_t> many{1, 2, 3, 4, 5, 6, 7, 8};
+    select->reset();
+    select->bind(Bind(many));
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 6);
+}
+
+TEST_F(TestSlight, carray_flt)
+{
+    std::vector<double> values{0.0, 1.5};
+    auto select = db->prepare("SELECT count(*) FROM test WHERE slight_float IN carray(?)");
+    select->bind(Bind(values));
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 4);
+}
+
+TEST_F(TestSlight, carray_str)
+{
+    std::vector<std::string> names{"name2", "future proof", "missing"};
+    auto select = db->prepare("SELECT count(*) FROM test WHERE name IN carray(:names)");
+    select->bind(Bind(":names", names));
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 4);
+}
+
+TEST_F(TestSlight, carray_empty)
+{
+    std::vector<int64_t> ids;
+    auto select = db->prepare("SELECT count(*) FROM test WHERE id IN carray(?)");
+    select->bind(Bind(ids));
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 0);
+}
+
+TEST_F(TestSlight, carray_unbound)
+{
+    auto select = db->prepare("SELECT count(*) FROM carray");
+    select->step();
+    EXPECT_FALSE(select->error());
+    EXPECT_EQ(select->get<slight::i32>(1), 0);
+}
+
+TEST_F(TestSlight, register_function_i64)
+{
+    EXPECT_TRUE(db->register_function("twice", [](int64_t x) { return x * 2; }));
+
+    auto select = db->prepare("SELECT twice(id) FROM test WHERE id = 3");
+    select->step();
+    EXPECT_EQ(select->get<slight::i64>(1), 6);
+}
+
+TEST_F(TestSlight, register_function_filter)
+{
+    db->register_function("starts_with", [](const char* str, const char* prefix) {
+        return str && prefix && strncmp(str, prefix, strlen(prefix)) == 0;
+    });
+
+    auto select = db->prepare("SELECT count(*) FROM test WHERE starts_with(name, 'name')");
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 3);
+}
+
+TEST_F(TestSlight, register_function_text_result)
+{
+    db->register_function("shout", [](std::string str) { return str + "!"; });
+
+    auto select = db->prepare("SELECT shout(name) FROM test WHERE id = 1");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "name1!");
+}
+
+TEST_F(TestSlight, register_function_state)
+{
+    int calls = 0;
+    db->register_function("counted", [&calls](double x) { calls++; return x + 0.5; }, false);
+
+    auto select = db->prepare("SELECT counted(id) FROM test");
+    while (select->step()) {}
+    EXPECT_EQ(calls, 6);
+}
+
+TEST_F(TestSlight, register_function_deterministic_index)
+{
+    db->register_function("lower_name", [](std::string str) {
+        for (auto& c : str)
+            c = static_cast<char>(tolower(c));
+        return str;
+    });
+
+    auto index = db->prepare("CREATE INDEX test_lower_name ON test(lower_name(name))");
+    index->step();
+    EXPECT_TRUE(index->done());
+}
+
+TEST_F(TestSlight, register_function_nondeterministic_index)
+{
+    db->register_function("noisy", [](int64_t x) { return x; }, false);
+
+    auto index = db->prepare("CREATE INDEX test_noisy ON test(noisy(id))");
+    index->step();
+    EXPECT_TRUE(index->error());
+}
+
+TEST_F(TestSlight, register_function_wrong_arg_count)
+{
+    db->register_function("twice", [](int64_t x) { return x * 2; });
+
+    auto select = db->prepare("SELECT twice(1, 2)");
+    EXPECT_TRUE(select->error());
+}
+
+TEST_F(TestSlight, register_function_throws)
+{
+    db->register_function("fail", [](int64_t) -> int64_t { throw std::runtime_error("nope"); });
+
+    auto select = db->prepare("SELECT fail(1)");
+    select->step();
+    EXPECT_TRUE(select->error());
+    EXPECT_EQ(select->error_msg(), "nope");
+}
+
+struct WeightedSum {
+    double total;
+    double weight;
+};
+
+TEST_F(TestSlight, register_aggregate)
+{
+    EXPECT_TRUE(db->register_aggregate<WeightedSum>(
+        "weighted_avg",
+        [](WeightedSum& s, double value, double weight) { s.total += value * weight; s.weight += weight; },
+        [](WeightedSum& s) { return s.weight == 0.0 ? 0.0 : s.total / s.weight; }));
+
+    auto select = db->prepare("SELECT weighted_avg(id, slight_int32 = 0) FROM test");
+    select->step();
+    EXPECT_DOUBLE_EQ(select->get<slight::flt>(1), (1.0 + 4.0 + 5.0 + 6.0) / 4.0);
+}
+
+TEST_F(TestSlight, register_aggregate_empty_group)
+{
+    db->register_aggregate<WeightedSum>(
+        "weighted_avg",
+        [](WeightedSum& s, double value, double weight) { s.total += value * weight; s.weight += weight; },
+        [](WeightedSum& s) { return s.weight == 0.0 ? -1.0 : s.total / s.weight; });
+
+    auto select = db->prepare("SELECT weighted_avg(id, 1) FROM test WHERE id > 100");
+    select->step();
+    EXPECT_DOUBLE_EQ(select->get<slight::flt>(1), -1.0);
+}
+
+TEST_F(TestSlight, register_aggregate_group_by)
+{
+    db->register_aggregate<std::vector<int64_t>>(
+        "median",
+        [](std::vector<int64_t>& values, int64_t value) { values.push_back(value); },
+        [](std::vector<int64_t>& values) {
+            std::sort(values.begin(), values.end());
+            return values.empty() ? 0 : values[values.size() / 2];
+        });
+
+    auto select = db->prepare("SELECT name, median(id) FROM test GROUP BY name ORDER BY name");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "future proof");
+    EXPECT_EQ(select->get<slight::i64>(2), 5);
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "name1");
+    EXPECT_EQ(select->get<slight::i64>(2), 1);
+}
+
+TEST_F(TestSlight, register_aggregate_window)
+{
+    db->register_aggregate<int64_t>(
+        "running_sum",
+        [](int64_t& sum, int64_t value) { sum += value; },
+        [](int64_t& sum) { return sum; },
+        [](int64_t& sum, int64_t value) { sum -= value; });
+
+    auto select = db->prepare(
+        "SELECT running_sum(id) OVER (ORDER BY id ROWS BETWEEN 1 PRECEDING AND CURRENT ROW) FROM test");
+    std::vector<int64_t> sums;
+    while (select->step())
+        sums.push_back(select->get<slight::i64>(1));
+    EXPECT_EQ(sums, (std::vector<int64_t>{1, 3, 5, 7, 9, 11}));
+}
+
+TEST_F(TestSlight, vec_kernels)
+{
+    std::vector<float> a(37), b(37);
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        a[i] = static_cast<float>(i) * 0.25f;
+        b[i] = 1.0f - static_cast<float>(i) * 0.125f;
+    }
+
+    float dot = 0, aa = 0, bb = 0, l2 = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        dot += a[i] * b[i];
+        aa += a[i] * a[i];
+        bb += b[i] * b[i];
+        l2 += (a[i] - b[i]) * (a[i] - b[i]);
+    }
+
+    EXPECT_NEAR(slight::vec::dot(a.data(), b.data(), a.size()), dot, 1e-3);
+    EXPECT_NEAR(slight::vec::cosine(a.data(), b.data(), a.size()), dot / std::sqrt(aa * bb), 1e-5);
+    EXPECT_NEAR(slight::vec::l2(a.data(), b.data(), a.size()), std::sqrt(l2), 1e-4);
+}
+
+std::string hex_blob(const std::vector<float>& values)
+{
+    static const char* digits = "0123456789ABCDEF";
+    auto bytes = reinterpret_cast<const unsigned char*>(values.data());
+    std::string hex = "X'";
+    for (size_t i = 0; i < values.size() * sizeof(float); i++)
+    {
+        hex += digits[bytes[i] >> 4];
+        hex += digits[bytes[i] & 0xf];
+    }
+    return hex + "'";
+}
+
+class TestVec : public TestSlight {
+public:
+    TestVec()
+    {
+        auto create = db->prepare("CREATE TABLE docs(id INTEGER PRIMARY KEY, embedding BLOB)");
+        create->step();
+        check(*create);
+
+        std::vector<std::vector<float>> embeddings{{1, 0, 0}, {0, 1, 0}, {0.9f, 0.1f, 0}, {-1, 0, 0}};
+        for (const auto& embedding : embeddings)
+        {
+            auto insert = db->prepare("INSERT INTO docs(embedding) VALUES (" + hex_blob(embedding) + ")");
+            insert->step();
+            check(*insert);
+        }
+    }
+};
+
+TEST_F(TestVec, vec_sql_functions)
+{
+    auto select = db->prepare(
+        "SELECT vec_dot(embedding, " + hex_blob({1, 0, 0}) + "), "
+        "vec_cosine(embedding, " + hex_blob({2, 0, 0}) + "), "
+        "vec_l2(embedding, " + hex_blob({1, 0, 0}) + ") FROM docs WHERE id = 4");
+    select->step();
+    check(*select);
+    EXPECT_DOUBLE_EQ(select->get<slight::flt>(1), -1.0);
+    EXPECT_DOUBLE_EQ(select->get<slight::flt>(2), -1.0);
+    EXPECT_DOUBLE_EQ(select->get<slight::flt>(3), 2.0);
+}
+
+TEST_F(TestVec, vec_dimension_mismatch)
+{
+    auto select = db->prepare("SELECT vec_dot(embedding, " + hex_blob({1, 0}) + ") FROM docs");
+    select->step();
+    EXPECT_TRUE(select->error());
+}
+
+TEST_F(TestVec, vec_null)
+{
+    auto select = db->prepare("SELECT vec_l2(NULL, embedding) IS NULL FROM docs");
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 1);
+}
+
+TEST_F(TestVec, top_k_largest)
+{
+    auto select = db->prepare("SELECT id, vec_cosine(embedding, " + hex_blob({1, 0, 0}) + ") FROM docs");
+    auto matches = slight::vec::top_k(*select, 2);
+    ASSERT_EQ(matches.size(), 2u);
+    EXPECT_EQ(matches[0].id, 1);
+    EXPECT_EQ(matches[1].id, 3);
+}
+
+TEST_F(TestVec, top_k_smallest)
+{
+    auto select = db->prepare("SELECT id, vec_l2(embedding, " + hex_blob({-1, 0, 0}) + ") FROM docs");
+    auto matches = slight::vec::top_k(*select, 10, slight::vec::Order::smallest);
+    ASSERT_EQ(matches.size(), 4u);
+    EXPECT_EQ(matches[0].id, 4);
+    EXPECT_DOUBLE_EQ(matches[0].score, 0.0);
+    EXPECT_EQ(matches[3].id, 1);
+}
+
+struct LiveOrder {
+    int64_t id;
+    std::string symbol;
+    double price;
+};
+
+class TestVtab : public TestSlight {
+public:
+    TestVtab()
+        : orders{{10, "AAA", 1.5}, {20, "BBB", 2.5}, {20, "BBC", 2.75}, {30, "CCC", 3.5}, {40, "DDD", 4.5}}
+    {
+        EXPECT_TRUE(db->register_vtab("live_orders", orders, {
+            slight::key_column("id", &LiveOrder::id),
+            slight::column("symbol", &LiveOrder::symbol),
+            slight::column("price", &LiveOrder::price)}));
+    }
+
+    std::vector<LiveOrder> orders;
+};
+
+TEST_F(TestVtab, vtab_scan)
+{
+    auto select = db->prepare("SELECT id, symbol, price FROM live_orders");
+    std::vector<std::string> symbols;
+    while (select->step())
+        symbols.push_back(select->get<slight::text>(2));
+    EXPECT_TRUE(select->done());
+    EXPECT_EQ(symbols, (std::vector<std::string>{"AAA", "BBB", "BBC", "CCC", "DDD"}));
+}
+
+TEST_F(TestVtab, vtab_key_eq)
+{
+    auto select = db->prepare("SELECT symbol FROM live_orders WHERE id = ?");
+    select->bind(Bind(static_cast<int64_t>(20)));
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "BBB");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "BBC");
+    select->step();
+    EXPECT_TRUE(select->done());
+}
+
+TEST_F(TestVtab, vtab_key_applies_affinity)
+{
+    auto select = db->prepare("SELECT symbol FROM live_orders WHERE id = '30'");
+    ASSERT_TRUE(select->step());
+    EXPECT_STREQ(select->get<slight::text>(1), "CCC");
+
+    auto range = db->prepare("SELECT count(*) FROM live_orders WHERE id >= ? AND id < '40'");
+    range->bind(Bind("20"));
+    range->step();
+    EXPECT_EQ(range->get<slight::i32>(1), 3);
+}
+
+TEST_F(TestVtab, vtab_key_range)
+{
+    auto select = db->prepare("SELECT count(*), sum(price) FROM live_orders WHERE id > 10 AND id <= 30");
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 3);
+    EXPECT_DOUBLE_EQ(select->get<slight::flt>(2), 2.5 + 2.75 + 3.5);
+}
+
+TEST_F(TestVtab, vtab_key_missing)
+{
+    auto select = db->prepare("SELECT count(*) FROM live_orders WHERE id = 25 OR id > 100");
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 0);
+}
+
+TEST_F(TestVtab, vtab_join)
+{
+    auto select = db->prepare(
+        "SELECT test.name, live_orders.symbol FROM test JOIN live_orders ON live_orders.id = test.id * 10 "
+        "ORDER BY test.id");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "name1");
+    EXPECT_STREQ(select->get<slight::text>(2), "AAA");
+    int rows = 1;
+    while (select->step())
+        rows++;
+    EXPECT_EQ(rows, 5);
+}
+
+TEST_F(TestVtab, vtab_sees_live_data)
+{
+    orders.push_back({50, "EEE", 5.5});
+
+    auto select = db->prepare("SELECT symbol FROM live_orders WHERE id = 50");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "EEE");
+}
+
+TEST_F(TestVtab, vtab_read_only)
+{
+    auto insert = db->prepare("INSERT INTO live_orders VALUES (60, 'FFF', 6.5)");
+    insert->step();
+    EXPECT_TRUE(insert->error());
+}
+
+TEST_F(TestVtab, vtab_text_key_other_collation)
+{
+    EXPECT_TRUE(db->register_vtab("by_symbol", orders, {
+        slight::key_column("symbol", &LiveOrder::symbol),
+        slight::column("id", &LiveOrder::id)}));
+
+    auto nocase = db->prepare("SELECT id FROM by_symbol WHERE symbol = 'bbc' COLLATE NOCASE");
+    ASSERT_TRUE(nocase->step());
+    EXPECT_EQ(nocase->get<slight::i64>(1), 20);
+
+    auto binary = db->prepare("SELECT count(*) FROM by_symbol WHERE symbol >= 'BBB' AND symbol < 'CCC'");
+    binary->step();
+    EXPECT_EQ(binary->get<slight::i32>(1), 2);
+}
+
+TEST_F(TestVtab, vtab_key_seek_plan)
+{
+    auto plan = db->prepare("EXPLAIN QUERY PLAN SELECT symbol FROM live_orders WHERE id = 20");
+    plan->step();
+    EXPECT_NE(strstr(plan->get<slight::text>(4), "INDEX 1:"), nullptr);
+}
+
+void write_file(const char* path, const std::string& contents)
+{
+    FILE* f = fopen(path, "wb");
+    fwrite(contents.data(), 1, contents.size(), f);
+    fclose(f);
+}
+
+TEST_F(TestSlight, load_csv_create_table)
+{
+    write_file("tests.csv", "id,name,score\n1,alpha,1.5\n2,\"be,ta\",2\n3,\"say \"\"hi\"\"\",\n");
+
+    slight::CsvOptions options;
+    options.create_table = true;
+    auto result = slight::load_csv(*db, "loaded", "tests.csv", options);
+    EXPECT_FALSE(result.error()) << result.error_msg;
+    EXPECT_EQ(result.rows, 3u);
+
+    auto select = db->prepare("SELECT id, name, score, typeof(score) FROM loaded ORDER BY id");
+    select->step();
+    EXPECT_EQ(select->get<slight::i64>(1), 1);
+    EXPECT_STREQ(select->get<slight::text>(2), "alpha");
+    EXPECT_DOUBLE_EQ(select->get<slight::flt>(3), 1.5);
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(2), "be,ta");
+    EXPECT_STREQ(select->get<slight::text>(4), "integer");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(2), "say \"hi\"");
+    EXPECT_STREQ(select->get<slight::text>(4), "null");
+}
+
+TEST_F(TestSlight, load_tsv_existing_table)
+{
+    write_file("tests.tsv", "4\tname4\r\n5\t\"multi\nline\"\r\n");
+
+    auto create = db->prepare("CREATE TABLE people(id INTEGER PRIMARY KEY, name TEXT)");
+    create->step();
+
+    slight::CsvOptions options;
+    options.delimiter = '\t';
+    options.header = false;
+    auto result = slight::load_csv(*db, "people", "tests.tsv", options);
+    EXPECT_FALSE(result.error()) << result.error_msg;
+    EXPECT_EQ(result.rows, 2u);
+
+    auto select = db->prepare("SELECT name FROM people WHERE id = 5");
+    select->step();
+    EXPECT_STREQ(select->get<slight::text>(1), "multi\nline");
+}
+
+TEST_F(TestSlight, load_csv_field_count_mismatch)
+{
+    write_file("tests.csv", "a,b\n1,2\n3,4,5\n");
+
+    slight::CsvOptions options;
+    options.create_table = true;
+    auto result = slight::load_csv(*db, "bad", "tests.csv", options);
+    EXPECT_TRUE(result.error());
+    EXPECT_EQ(result.rows, 0u);
+
+    auto select = db->prepare("SELECT count(*) FROM bad");
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 0);
+}
+
+TEST_F(TestSlight, load_csv_blank_lines)
+{
+    write_file("tests.csv", "a,b\n1,2\n\n3,4\n");
+    slight::CsvOptions options;
+    options.create_table = true;
+    EXPECT_EQ(slight::load_csv(*db, "pairs", "tests.csv", options).rows, 2u);
+
+    write_file("tests.csv", "v\n1\n\n3\n");
+    auto result = slight::load_csv(*db, "single", "tests.csv", options);
+    EXPECT_FALSE(result.error()) << result.error_msg;
+    EXPECT_EQ(result.rows, 3u);
+
+    auto select = db->prepare("SELECT count(*) FROM single WHERE v IS NULL");
+    select->step();
+    EXPECT_EQ(select->get<slight::i32>(1), 1);
+}
+
+TEST_F(TestSlight, load_csv_busy_commit_counts_nothing)
+{
+    write_file("tests.csv", "a,b\n1,2\n3,4\n5,6\n");
+    db->prepare("CREATE TABLE busy(a, b)")->step();
+
+    // a reader on another connection keeps COMMIT from taking its lock
+    sqlite3* reader = nullptr;
+    sqlite3_open("tests.db", &reader);
+    sqlite3_stmt* read = nullptr;
+    sqlite3_prepare_v2(reader, "SELECT name FROM test", -1, &read, nullptr);
+    ASSERT_EQ(sqlite3_step(read), SQLITE_ROW);
+
+    slight::CsvOptions options;
+    options.batch_rows = 1;
+    options.transaction_rows = 2;
+    auto result = slight::load_csv(*db, "busy", "tests.csv", options);
+    sqlite3_finalize(read);
+    sqlite3_close(reader);
+
+    EXPECT_TRUE(result.error());
+    auto count = db->prepare("SELECT count(*) FROM busy");
+    count->step();
+    EXPECT_EQ(result.rows, static_cast<std::size_t>(count->get<slight::i64>(1)));
+}
+
+TEST_F(TestSlight, load_csv_missing_file)
+{
+    auto result = slight::load_csv(*db, "test", "does-not-exist.csv");
+    EXPECT_TRUE(result.error());
+}
+
+TEST_F(TestSlight, load_csv_parallel)
+{
+    std::string csv = "id,label,value\n";
+    int64_t expected = 0;
+    for (int i = 0; i < 100000; i++)
+    {
+        csv += std::to_string(i) + ",\"label, " + std::to_string(i) + "\n(quoted)\"," + std::to_string(i * 3) + "\n";
+        expected += i * 3;
+    }
+    write_file("tests.csv", csv);
+
+    slight::CsvOptions options;
+    options.create_table = true;
+    options.threads = 4;
+    options.batch_rows = 1000;
+    options.transaction_rows = 30000;
+    auto result = slight::load_csv(*db, "big", "tests.csv", options);
+    EXPECT_FALSE(result.error()) << result.error_msg;
+    EXPECT_EQ(result.rows, 100000u);
+
+    auto select = db->prepare("SELECT count(*), sum(value), count(DISTINCT id) FROM big");
+    select->step();
+    EXPECT_EQ(select->get<slight::i64>(1), 100000);
+    EXPECT_EQ(select->get<slight::i64>(2), expected);
+    EXPECT_EQ(select->get<slight::i64>(3), 100000);
+}
+
+TEST_F(TestSlight, write_to_csv)
+{
+    auto insert = db->prepare("INSERT INTO test (name, slight_int32, slight_float) VALUES ('a,\"b\"', NULL, 0.1)");
+    insert->step();
+
+    auto select = db->prepare("SELECT id, name, slight_int32, slight_float FROM test WHERE id IN (1, 7)");
+    std::ostringstream out;
+    EXPECT_EQ(select->write_to(out, slight::Format::csv), 2u);
+    EXPECT_TRUE(select->done());
+    EXPECT_EQ(out.str(),
+        "id,name,slight_int32,slight_float\n"
+        "1,name1,0,0.0\n"
+        "7,\"a,\"\"b\"\"\",,0.1\n");
+}
+
+TEST_F(TestSlight, write_to_ndjson)
+{
+    auto select = db->prepare("SELECT id, name AS \"the \"\"name\"\"\", x'00ff' AS raw, NULL AS missing FROM test WHERE id <= 2");
+    std::ostringstream out;
+    EXPECT_EQ(select->write_to(out, slight::Format::ndjson), 2u);
+    EXPECT_EQ(out.str(),
+        "{\"id\":1,\"the \\\"name\\\"\":\"name1\",\"raw\":\"00ff\",\"missing\":null}\n"
+        "{\"id\":2,\"the \\\"name\\\"\":\"name2\",\"raw\":\"00ff\",\"missing\":null}\n");
+}
+
+TEST_F(TestSlight, write_to_binary)
+{
+    auto select = db->prepare("SELECT id, name, -1.5 FROM test WHERE id = 3");
+    std::ostringstream out;
+    EXPECT_EQ(select->write_to(out, slight::Format::binary), 1u);
+
+    std::string expected("SLT1\x03\x02id\x04name\x04-1.5", 18);
+    expected += std::string("\x01\x06", 2);              // integer 3, zigzag 6
+    expected += std::string("\x03\x05name3", 7);         // text
+    expected += std::string("\x02\x00\x00\x00\x00\x00\x00\xf8\xbf", 9); // real -1.5
+    EXPECT_EQ(out.str(), expected);
+}
+
+TEST_F(TestSlight, write_to_includes_current_row)
+{
+    auto select = db->prepare("SELECT id FROM test");
+    select->step();
+    select->step();
+    std::ostringstream out;
+    EXPECT_EQ(select->write_to(out, slight::Format::csv), 5u);
+    EXPECT_EQ(out.str(), "id\n2\n3\n4\n5\n6\n");
+}
+
+TEST_F(TestSlight, write_to_fd)
+{
+    FILE* f = tmpfile();
+    auto select = db->prepare("SELECT name FROM test WHERE id = 2");
+    EXPECT_EQ(select->write_to(fileno(f), slight::Format::csv), 1u);
+    EXPECT_FALSE(select->error());
+
+    char contents[64] = {};
+    rewind(f);
+    fread(contents, 1, sizeof(contents) - 1, f);
+    fclose(f);
+    EXPECT_STREQ(contents, "name\nname2\n");
+}
+
+TEST_F(TestSlight, write_to_bad_fd)
+{
+    auto select = db->prepare("SELECT name FROM test");
+    select->write_to(-1, slight::Format::ndjson);
+    EXPECT_TRUE(select->error());
+    EXPECT_EQ(select->error_code(), SQLITE_IOERR);
+}
+
+TEST_F(TestSlight, query_materializes_rows)
+{
+    auto result = db->query("SELECT id, name, slight_float, NULL FROM test WHERE id <= ?", {Bind(2)});
+    ASSERT_FALSE(result->error());
+    ASSERT_EQ(result->size(), 2u);
+    EXPECT_EQ(result->columns(), 4);
+    EXPECT_EQ(result->column_name(2), "name");
+    EXPECT_EQ((*result)[1].get<slight::i64>(1), 2);
+    EXPECT_STREQ((*result)[1].get<slight::text>(2), "name2");
+    EXPECT_TRUE((*result)[0].is_null(4));
+    EXPECT_FALSE((*result)[0].is_null(3));
+}
+
+TEST_F(TestSlight, query_cache_hits_and_invalidates)
+{
+    db->enable_result_cache(1 << 20);
+
+    auto first = db->query("SELECT count(*) FROM test");
+    auto second = db->query("SELECT   count(*)\n FROM test");
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(db->result_cache_stats().hits, 1u);
+    EXPECT_EQ(db->result_cache_stats().misses, 1u);
+
+    auto insert = db->prepare("INSERT INTO test (name) VALUES ('cached')");
+    insert->step();
+
+    auto third = db->query("SELECT count(*) FROM test");
+    EXPECT_NE(first, third);
+    EXPECT_EQ((*third)[0].get<slight::i64>(1), 7);
+    EXPECT_EQ(db->result_cache_stats().invalidations, 1u);
+}
+
+TEST_F(TestSlight, query_cache_keeps_comments)
+{
+    db->enable_result_cache(1 << 20);
+
+    auto both = db->query("SELECT 1 -- x\n, 2");
+    auto one = db->query("SELECT 1 -- x , 2");
+    EXPECT_EQ(both->columns(), 2);
+    EXPECT_EQ(one->columns(), 1);
+    EXPECT_EQ(db->result_cache_stats().misses, 2u);
+}
+
+TEST_F(TestSlight, query_cache_keys_on_binds)
+{
+    db->enable_result_cache(1 << 20);
+
+    auto a = db->query("SELECT name FROM test WHERE id = ?", {Bind(1)});
+    auto b = db->query("SELECT name FROM test WHERE id = ?", {Bind(2)});
+    EXPECT_STREQ((*a)[0].get<slight::text>(1), "name1");
+    EXPECT_STREQ((*b)[0].get<slight::text>(1), "name2");
+    EXPECT_EQ(db->result_cache_stats().hits, 0u);
+    EXPECT_EQ(db->result_cache_stats().entries, 2u);
+}
+
+TEST_F(TestSlight, query_cache_keys_on_whole_strings)
+{
+    db->enable_result_cache(1 << 20);
+
+    std::vector<std::string> b{std::string("a\0b", 3)};
+    std::vector<std::string> c{std::string("a\0c", 3)};
+    auto first = db->query("SELECT hex(value) FROM carray(?)", {Bind(1, b)});
+    auto second = db->query("SELECT hex(value) FROM carray(?)", {Bind(1, c)});
+    EXPECT_STREQ((*first)[0].get<slight::text>(1), "610062");
+    EXPECT_STREQ((*second)[0].get<slight::text>(1), "610063");
+    EXPECT_EQ(db->result_cache_stats().hits, 0u);
+}
+
+TEST_F(TestSlight, query_cache_skips_errors_and_evicts)
+{
+    db->enable_result_cache(1 << 20);
+    EXPECT_TRUE(db->query("SELECT nope FROM test")->error());
+    EXPECT_EQ(db->result_cache_stats().entries, 0u);
+
+    auto size = db->query("SELECT name FROM test WHERE id = 1")->bytes();
+    db->enable_result_cache(size * 3);
+    for (int id = 1; id <= 6; id++)
+        db->query("SELECT name FROM test WHERE id = ?", {Bind(id)});
+    EXPECT_GT(db->result_cache_stats().evictions, 0u);
+    EXPECT_LE(db->result_cache_stats().bytes, size * 3);
+}
+
+TEST_F(TestSlight, busy_policy_times_out_writer)
+{
+    db->prepare("BEGIN IMMEDIATE")->step();
+
+    auto other = slight::Database::make_read_write("tests.db");
+    slight::BusyPolicy policy;
+    policy.timeout = std::chrono::milliseconds(50);
+    policy.max_backoff = std::chrono::microseconds(5000);
+    other->set_busy_policy(policy);
+
+    auto insert = other->prepare("INSERT INTO test (name) VALUES ('blocked')");
+    insert->step();
+    EXPECT_EQ(insert->error_code(), SQLITE_BUSY);
+
+    auto stats = other->busy_stats();
+    EXPECT_EQ(stats.events, 1u);
+    EXPECT_EQ(stats.timeouts, 1u);
+    EXPECT_GT(stats.retries, 0u);
+    EXPECT_GE(stats.waited, std::chrono::milliseconds(25));
+
+    db->prepare("ROLLBACK")->step();
+}
+
+TEST_F(TestSlight, busy_policy_waits_for_writer)
+{
+    db->prepare("BEGIN EXCLUSIVE")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('late')")->step();
+
+    auto other = slight::Database::make_read_only("tests.db");
+    other->set_busy_policy(slight::BusyPolicy());
+
+    std::thread writer([this] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        db->prepare("COMMIT")->step();
+    });
+    auto select = other->prepare("SELECT count(*) FROM test");
+    EXPECT_TRUE(select->step());
+    writer.join();
+
+    EXPECT_EQ(select->get<slight::i64>(1), 7);
+    EXPECT_GE(other->busy_stats().events, 1u);
+    EXPECT_EQ(other->busy_stats().timeouts, 0u);
+}
+
+TEST_F(TestSlight, busy_policy_max_retries)
+{
+    db->prepare("BEGIN EXCLUSIVE")->step();
+
+    auto other = slight::Database::make_read_only("tests.db");
+    slight::BusyPolicy policy;
+    policy.max_retries = 3;
+    other->set_busy_policy(policy);
+
+    auto select = other->prepare("SELECT count(*) FROM test");
+    EXPECT_FALSE(select->step());
+    EXPECT_EQ(select->error_code(), SQLITE_BUSY);
+    EXPECT_EQ(other->busy_stats().retries, 3u);
+
+    db->prepare("ROLLBACK")->step();
+}
+
+class TestShard : public ::testing::Test {
+public:
+    TestShard()
+    {
+        for (int i = 0; i < 4; i++)
+            remove(("shards.db." + std::to_string(i)).c_str());
+        shards = slight::ShardedDatabase::make_create_read_write("shards.db", 4);
+        for (std::size_t i = 0; i < shards->size(); i++)
+            (*shards)[i].prepare("CREATE TABLE kv(id INTEGER PRIMARY KEY, value TEXT)")->step();
+
+        for (int64_t id = 1; id <= 100; id++)
+        {
+            // text is bound without a copy, so it has to outlive step()
+            std::string name = std::to_string(id);
+            auto insert = shards->prepare(id, "INSERT INTO kv VALUES (?, ?)");
+            insert->bind({Bind(id), Bind(name.c_str())});
+            insert->step();
+        }
+    }
+
+    std::unique_ptr<slight::ShardedDatabase> shards;
+};
+
+TEST_F(TestShard, shard_routes_point_reads)
+{
+    EXPECT_TRUE(shards->opened());
+    EXPECT_EQ(shards->shard_for(42), shards->shard_for(42));
+    EXPECT_LT(shards->shard_for("some key"), 4u);
+
+    auto select = shards->prepare(42, "SELECT value FROM kv WHERE id = 42");
+    ASSERT_TRUE(select->step());
+    EXPECT_STREQ(select->get<slight::text>(1), "42");
+
+    auto other = (*shards)[(shards->shard_for(42) + 1) % 4].prepare("SELECT value FROM kv WHERE id = 42");
+    EXPECT_FALSE(other->step());
+}
+
+TEST_F(TestShard, shard_spreads_keys)
+{
+    for (std::size_t i = 0; i < shards->size(); i++)
+    {
+        auto count = (*shards)[i].prepare("SELECT count(*) FROM kv");
+        count->step();
+        EXPECT_GT(count->get<slight::i64>(1), 10);
+    }
+}
+
+TEST_F(TestShard, shard_scatter_concatenates)
+{
+    auto gathered = shards->scatter("SELECT count(*) FROM kv WHERE id > ?", {Bind(50)});
+    ASSERT_FALSE(gathered.error());
+    ASSERT_EQ(gathered.rows.size(), 4u);
+    int64_t total = 0;
+    for (const auto& row : gathered.rows)
+        total += row.get<slight::i64>(1);
+    EXPECT_EQ(total, 50);
+}
+
+TEST_F(TestShard, shard_scatter_merges_in_order)
+{
+    slight::MergeKey key;
+    auto ascending = shards->scatter("SELECT id FROM kv ORDER BY id", key);
+    ASSERT_EQ(ascending.rows.size(), 100u);
+    for (int64_t i = 0; i < 100; i++)
+        EXPECT_EQ(ascending.rows[i].get<slight::i64>(1), i + 1);
+
+    key.descending = true;
+    key.type = slight::text;
+    auto descending = shards->scatter("SELECT value FROM kv ORDER BY value DESC", key);
+    ASSERT_EQ(descending.rows.size(), 100u);
+    EXPECT_STREQ(descending.rows.front().get<slight::text>(1), "99");
+    EXPECT_STREQ(descending.rows.back().get<slight::text>(1), "1");
+}
+
+TEST_F(TestShard, shard_scatter_error)
+{
+    auto gathered = shards->scatter("SELECT nope FROM kv");
+    EXPECT_TRUE(gathered.error());
+    EXPECT_TRUE(gathered.rows.empty());
+}
+
+TEST_F(TestShard, shard_none_is_an_error)
+{
+    auto none = slight::ShardedDatabase::make_create_read_write("shards.db", 0);
+    EXPECT_TRUE(none->error());
+    EXPECT_FALSE(none->opened());
+    EXPECT_EQ(none->shard_for(42), 0u);
+    EXPECT_EQ(none->prepare(42, "SELECT 1"), nullptr);
+    EXPECT_EQ(none->scatter("SELECT 1").error_code, SQLITE_MISUSE);
+    EXPECT_TRUE(none->scatter("SELECT 1", slight::MergeKey()).error());
+}
+
+TEST_F(TestSlight, parallel_scan_sums_partitions)
+{
+    db->prepare("WITH RECURSIVE n(v) AS (SELECT 1 UNION ALL SELECT v + 1 FROM n WHERE v < 1000) "
+                "INSERT INTO test (name, slight_int64) SELECT 'bulk', v FROM n")->step();
+
+    std::vector<std::size_t> seen;
+    int64_t total = 0;
+    slight::ScanOptions options;
+    options.threads = 4;
+    auto result = slight::parallel_scan(
+        "tests.db", "test",
+        "SELECT sum(slight_int64) FROM test WHERE name = 'bulk' AND rowid BETWEEN :lo AND :hi",
+        8,
+        [&](std::size_t partition, const slight::ResultSet& rows) {
+            seen.push_back(partition);
+            total += rows[0].get<slight::i64>(1);
+        },
+        options);
+
+    ASSERT_FALSE(result.error()) << result.error_msg;
+    EXPECT_EQ(result.partitions, 8u);
+    std::sort(seen.begin(), seen.end());
+    EXPECT_EQ(seen, (std::vector<std::size_t>{0, 1, 2, 3, 4, 5, 6, 7}));
+    EXPECT_EQ(total, 500500);
+}
+
+TEST_F(TestSlight, parallel_scan_more_partitions_than_rows)
+{
+    std::size_t rows = 0;
+    auto result = slight::parallel_scan(
+        "tests.db", "test", "SELECT id FROM test WHERE rowid BETWEEN :lo AND :hi", 100,
+        [&](std::size_t, const slight::ResultSet& set) { rows += set.size(); });
+    EXPECT_FALSE(result.error());
+    EXPECT_EQ(result.partitions, 6u);
+    EXPECT_EQ(rows, 6u);
+}
+
+TEST_F(TestSlight, parallel_scan_error)
+{
+    auto result = slight::parallel_scan(
+        "tests.db", "test", "SELECT nope FROM test WHERE rowid BETWEEN :lo AND :hi", 4,
+        [](std::size_t, const slight::ResultSet&) { FAIL(); });
+    EXPECT_TRUE(result.error());
+    EXPECT_EQ(result.partitions, 0u);
+}
+
+TEST_F(TestSlight, write_queue_group_commits)
+{
+    slight::WriteQueueOptions options;
+    options.max_batch = 64;
+    std::unique_ptr<slight::WriteQueue> queue(
+        new slight::WriteQueue(slight::Database::make_read_write("tests.db"), options));
+
+    std::vector<std::future<int>> results[4];
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; t++)
+    {
+        producers.emplace_back([&, t] {
+            for (int i = 0; i < 100; i++)
+                results[t].push_back(queue->submit("INSERT INTO test (name) VALUES ('queued')"));
+        });
+    }
+    for (auto& producer : producers)
+        producer.join();
+    for (auto& futures : results)
+        for (auto& result : futures)
+            EXPECT_EQ(result.get(), SQLITE_OK);
+
+    auto stats = queue->stats();
+    EXPECT_EQ(stats.jobs, 400u);
+    EXPECT_LT(stats.batches, 400u);
+    EXPECT_GE(stats.batches, 400u / 64);
+    queue.reset();
+
+    auto count = db->prepare("SELECT count(*) FROM test WHERE name = 'queued'");
+    count->step();
+    EXPECT_EQ(count->get<slight::i64>(1), 400);
+}
+
+TEST_F(TestSlight, write_queue_failed_job_rolls_back_alone)
+{
+    slight::WriteQueue queue(slight::Database::make_read_write("tests.db"));
+
+    auto good = queue.submit("INSERT INTO test (name) VALUES ('kept')");
+    auto bad = queue.submit([](slight::Database& db) {
+        auto insert = db.prepare("INSERT INTO test (name) VALUES ('dropped')");
+        insert->step();
+        return SQLITE_CONSTRAINT;
+    });
+    auto invalid = queue.submit("INSERT INTO nope VALUES (1)");
+
+    EXPECT_EQ(good.get(), SQLITE_OK);
+    EXPECT_EQ(bad.get(), SQLITE_CONSTRAINT);
+    EXPECT_EQ(invalid.get(), SQLITE_ERROR);
+    EXPECT_GE(queue.stats().failed_jobs, 2u);
+
+    auto count = db->prepare("SELECT count(*) FROM test WHERE name IN ('kept', 'dropped')");
+    count->step();
+    EXPECT_EQ(count->get<slight::i64>(1), 1);
+}
+
+TEST_F(TestSlight, snapshot_pins_reads)
+{
+    db->prepare("PRAGMA journal_mode=WAL")->step();
+    auto snapshot = db->snapshot();
+    if (snapshot->error())
+        GTEST_SKIP() << snapshot->error_msg();
+
+    auto writer = slight::Database::make_read_write("tests.db");
+    writer->prepare("INSERT INTO test (name) VALUES ('after')")->step();
+
+    auto reader = slight::Database::make_read_only("tests.db");
+    ASSERT_TRUE(reader->open_snapshot(*snapshot));
+    auto count = reader->prepare("SELECT count(*) FROM test");
+    count->step();
+    EXPECT_EQ(count->get<slight::i64>(1), 6);
+    EXPECT_FALSE(reader->open_snapshot(*snapshot));
+    reader->end_read();
+
+    auto later = reader->snapshot();
+    ASSERT_FALSE(later->error());
+    EXPECT_GT(later->compare(*snapshot), 0);
+    reader->end_read();
+    db->end_read();
+}
+
+TEST_F(TestSlight, snapshot_needs_wal)
+{
+    auto snapshot = db->snapshot();
+    EXPECT_TRUE(snapshot->error());
+    EXPECT_TRUE(sqlite3_get_autocommit(db->handle())); // no read left open
+}
+
+TEST_F(TestSlight, step_batch)
+{
+    auto select = db->prepare("SELECT id, name, slight_float, NULL FROM test ORDER BY id");
+    slight::RowBuffer rows;
+
+    EXPECT_EQ(select->step_batch(rows, 4), 4u);
+    EXPECT_EQ(rows.columns(), 4);
+    EXPECT_EQ(rows[0].get<slight::i64>(1), 1);
+    EXPECT_STREQ(rows[1].get<slight::text>(2), "name2");
+    EXPECT_TRUE(rows[3].is_null(4));
+    EXPECT_FALSE(select->done());
+
+    EXPECT_EQ(select->step_batch(rows, 4), 2u);
+    EXPECT_EQ(rows[0].get<slight::i64>(1), 5);
+    EXPECT_STREQ(rows[1].get<slight::text>(2), "future proof");
+    EXPECT_TRUE(select->done());
+}
+
+TEST_F(TestSlight, step_batch_reuses_memory)
+{
+    auto select = db->prepare("SELECT name FROM test");
+    slight::RowBuffer rows;
+    select->step_batch(rows, 6);
+    auto bytes = rows.bytes();
+
+    select->reset();
+    select->step_batch(rows, 6);
+    EXPECT_EQ(rows.size(), 6u);
+    EXPECT_EQ(rows.bytes(), bytes);
+}
+
+TEST_F(TestSlight, prefetch_cursor_reads_everything)
+{
+    auto select = db->prepare(
+        "WITH RECURSIVE n(v) AS (SELECT 1 UNION ALL SELECT v + 1 FROM n WHERE v < 1000) SELECT v, 'row' FROM n");
+    slight::PrefetchOptions options;
+    options.batch_rows = 64;
+    options.depth = 2;
+    slight::PrefetchCursor cursor(select, options);
+
+    std::size_t rows = 0;
+    int64_t sum = 0;
+    while (auto batch = cursor.next())
+    {
+        for (std::size_t r = 0; r < batch->size(); r++)
+        {
+            sum += (*batch)[r].get<slight::i64>(1);
+            EXPECT_STREQ((*batch)[r].get<slight::text>(2), "row");
+        }
+        rows += batch->size();
+    }
+    EXPECT_EQ(rows, 1000u);
+    EXPECT_EQ(sum, 500500);
+    EXPECT_FALSE(cursor.error());
+    EXPECT_EQ(cursor.next(), nullptr);
+}
+
+TEST_F(TestSlight, prefetch_cursor_stops_early)
+{
+    auto select = db->prepare(
+        "WITH RECURSIVE n(v) AS (SELECT 1 UNION ALL SELECT v + 1 FROM n WHERE v < 100000) SELECT v FROM n");
+    slight::PrefetchOptions options;
+    options.batch_rows = 16;
+    {
+        slight::PrefetchCursor cursor(select, options);
+        auto batch = cursor.next();
+        ASSERT_NE(batch, nullptr);
+        EXPECT_EQ((*batch)[0].get<slight::i64>(1), 1);
+    }
+    EXPECT_FALSE(select->done());
+}
+
+TEST_F(TestSlight, metrics_count_activity)
+{
+    auto before = db->metrics_snapshot();
+
+    auto select = db->prepare("SELECT name, id FROM test WHERE id <= ?");
+    select->bind(Bind(2));
+    while (select->step())
+    {
+        select->get<slight::text>(1);
+        select->get<slight::i64>(2);
+    }
+    db->prepare("SELECT nope FROM test");
+    db->prepare("BEGIN")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('metrics')")->step();
+    db->prepare("ROLLBACK")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('metrics')")->step();
+
+    auto after = db->metrics_snapshot();
+    EXPECT_EQ(after.prepares - before.prepares, 6u);
+    EXPECT_EQ(after.steps - before.steps, 7u);
+    EXPECT_EQ(after.rows - before.rows, 2u);
+    EXPECT_EQ(after.bytes_bound - before.bytes_bound, 8u);
+    EXPECT_EQ(after.bytes_read - before.bytes_read, 5u + 5u + 8u + 8u);
+    EXPECT_EQ(after.errors[SQLITE_ERROR], 1u);
+    EXPECT_EQ(after.rollbacks - before.rollbacks, 1u);
+    EXPECT_EQ(after.commits - before.commits, 1u);
+    EXPECT_GT(after.schema_used, 0);
+}
+
+TEST_F(TestSlight, metrics_count_batches_and_cache_hits)
+{
+    db->enable_result_cache(1 << 20);
+    db->query("SELECT name FROM test");
+    db->query("SELECT name FROM test");
+
+    slight::RowBuffer rows;
+    db->prepare("SELECT id FROM test")->step_batch(rows, 10);
+
+    auto metrics = db->metrics_snapshot();
+    EXPECT_EQ(metrics.result_cache_hits, 1u);
+    EXPECT_EQ(metrics.rows, 12u);
+}
+
+TEST_F(TestSlight, execute_script_runs_every_statement)
+{
+    const char script[] =
+        "CREATE TABLE kv(k TEXT, v INT);\n"
+        "-- fixtures\n"
+        "INSERT INTO kv VALUES ('a', 1);;\n"
+        "INSERT INTO kv VALUES ('b', 2);\n"
+        "SELECT * FROM kv;\n"
+        "  /* trailing comment */ ";
+    auto result = db->execute_script(script, sizeof(script) - 1, true);
+
+    ASSERT_FALSE(result.error()) << result.error_msg;
+    ASSERT_EQ(result.statements.size(), 4u);
+    EXPECT_EQ(result.statements[0].offset, 0u);
+    EXPECT_EQ(std::string(script + result.statements[1].offset, result.statements[1].length),
+              "-- fixtures\nINSERT INTO kv VALUES ('a', 1);");
+    EXPECT_EQ(result.statements[3].rows, 2u);
+
+    auto count = db->prepare("SELECT sum(v) FROM kv");
+    count->step();
+    EXPECT_EQ(count->get<slight::i64>(1), 3);
+}
+
+TEST_F(TestSlight, execute_script_stops_and_rolls_back)
+{
+    std::string script =
+        "INSERT INTO test (name) VALUES ('script'); INSERT INTO nope VALUES (1); INSERT INTO test (name) VALUES ('never');";
+    auto result = db->execute_script(script.data(), script.size(), true);
+    EXPECT_TRUE(result.error());
+    EXPECT_EQ(result.statements.size(), 2u);
+
+    auto count = db->prepare("SELECT count(*) FROM test WHERE name IN ('script', 'never')");
+    count->step();
+    EXPECT_EQ(count->get<slight::i64>(1), 0);
+}
+
+TEST_F(TestSlight, execute_script_without_transaction_keeps_earlier_statements)
+{
+    std::string script = "INSERT INTO test (name) VALUES ('script'); INSERT INTO nope VALUES (1);";
+    auto result = db->execute_script(script.data(), script.size());
+    EXPECT_EQ(result.error_code, SQLITE_ERROR);
+
+    auto count = db->prepare("SELECT count(*) FROM test WHERE name = 'script'");
+    count->step();
+    EXPECT_EQ(count->get<slight::i64>(1), 1);
+}
+
+TEST_F(TestSlight, datetime_parse_iso8601)
+{
+    using std::chrono::microseconds;
+    slight::DateTime t;
+    ASSERT_TRUE(slight::parse_iso8601("2024-02-29 13:45:06", 19, t));
+    EXPECT_EQ(t.time_since_epoch(), microseconds(1709214306000000));
+    ASSERT_TRUE(slight::parse_iso8601("2024-02-29T13:45:06.25+01:30", 28, t));
+    EXPECT_EQ(t.time_since_epoch(), microseconds(1709208906250000));
+    ASSERT_TRUE(slight::parse_iso8601("1969-12-31", 10, t));
+    EXPECT_EQ(t.time_since_epoch(), microseconds(-86400000000));
+
+    EXPECT_FALSE(slight::parse_iso8601("2023-02-29", 10, t));
+    EXPECT_FALSE(slight::parse_iso8601("2024-02-29 24:00:00", 19, t));
+    EXPECT_FALSE(slight::parse_iso8601("2024-02-29 13:45", 16, t));
+    EXPECT_FALSE(slight::parse_iso8601("2024/02/29", 10, t));
+    EXPECT_FALSE(slight::parse_iso8601("2024-02-29 13:45:06+", 20, t));
+}
+
+TEST_F(TestSlight, datetime_format_round_trips)
+{
+    char text[slight::iso8601_size];
+    slight::DateTime t(std::chrono::microseconds(-1));
+    ASSERT_EQ(slight::format_iso8601(t, text), slight::iso8601_size);
+    EXPECT_EQ(std::string(text, sizeof(text)), "1969-12-31T23:59:59.999999Z");
+
+    slight::DateTime parsed;
+    ASSERT_TRUE(slight::parse_iso8601(text, sizeof(text), parsed));
+    EXPECT_EQ(parsed, t);
+}
+
+TEST_F(TestSlight, datetime_bind_and_get)
+{
+    using namespace std::chrono;
+    slight::DateTime t(microseconds(1700000000123456));
+    db->prepare("CREATE TABLE events (at)")->step();
+    auto insert = db->prepare("INSERT INTO events VALUES (?)");
+    insert->bind({slight::Bind(1, t)});
+    insert->step();
+    insert->reset();
+    insert->bind({slight::Bind(1, t, slight::DateTimeFormat::iso8601)});
+    insert->step();
+
+    auto select = db->prepare("SELECT at, typeof(at), datetime(at) FROM events ORDER BY rowid");
+    ASSERT_TRUE(select->step());
+    EXPECT_STREQ(select->get<slight::text>(2), "integer");
+    EXPECT_EQ(select->get<slight::datetime>(1), t);
+    ASSERT_TRUE(select->step());
+    EXPECT_STREQ(select->get<slight::text>(2), "text");
+    EXPECT_EQ(select->get<slight::datetime>(1), t);
+    EXPECT_EQ(select->get<slight::datetime>(3), time_point_cast<seconds>(t));
+
+    auto result = db->query("SELECT at FROM events");
+    ASSERT_EQ(result->size(), 2u);
+    EXPECT_EQ((*result)[0].get<slight::datetime>(1), t);
+    EXPECT_EQ((*result)[1].get<slight::datetime>(1), t);
+}
+
+TEST_F(TestSlight, text_view_keeps_length)
+{
+    auto select = db->prepare("SELECT 'a' || char(0) || 'b', NULL, 42");
+    ASSERT_TRUE(select->step());
+    auto view = select->get<slight::text_view>(1);
+    EXPECT_EQ(view.size, 3u);
+    EXPECT_EQ(view.str(), std::string("a\0b", 3));
+    EXPECT_EQ(select->get<slight::text_view>(2).data, nullptr);
+    EXPECT_EQ(select->get<slight::text_view>(3).str(), "42");
+}
+
+TEST_F(TestSlight, get_into_reuses_string)
+{
+    std::string out;
+    out.reserve(64);
+    auto capacity = out.capacity();
+
+    auto select = db->prepare("SELECT 'first', NULL");
+    ASSERT_TRUE(select->step());
+    select->get_into(1, out);
+    EXPECT_EQ(out, "first");
+    EXPECT_EQ(out.capacity(), capacity);
+    select->get_into(2, out);
+    EXPECT_TRUE(out.empty());
+
+    auto result = db->query("SELECT 'row'");
+    (*result)[0].get_into(1, out);
+    EXPECT_EQ(out, "row");
+    EXPECT_EQ(out.capacity(), capacity);
+}
+
+TEST_F(TestSlight, get_optional_tells_null_apart)
+{
+    auto select = db->prepare("SELECT NULL, 0, '', 1.5, x'00'");
+    ASSERT_TRUE(select->step());
+    EXPECT_FALSE(select->get_optional<slight::i64>(1).has_value());
+    EXPECT_EQ(select->get_optional<slight::i64>(1).value_or(-1), -1);
+    EXPECT_EQ(*select->get_optional<slight::i64>(2), 0);
+    ASSERT_TRUE(select->get_optional<slight::text>(3));
+    EXPECT_STREQ(*select->get_optional<slight::text>(3), "");
+
+    EXPECT_EQ(select->column_type(1), slight::nil);
+    EXPECT_EQ(select->column_type(2), slight::i64);
+    EXPECT_EQ(select->column_type(3), slight::text);
+    EXPECT_EQ(select->column_type(4), slight::flt);
+    EXPECT_EQ(select->column_type(5), slight::blob);
+
+    auto result = db->query("SELECT NULL, 7");
+    EXPECT_FALSE((*result)[0].get_optional<slight::i32>(1));
+    EXPECT_EQ((*result)[0].get_optional<slight::i32>(2).value(), 7);
+    EXPECT_EQ((*result)[0].column_type(2), slight::i64);
+}
+
+TEST_F(TestSlight, json_each_rows)
+{
+    const char* json = R"({"a": 1, "b": [2.5, "x"], "c": null})";
+    auto each = slight::json_each(*db, json, "$.b");
+    std::vector<std::string> types;
+    while (each->step())
+        types.push_back(each->get<slight::text>(slight::JsonEach::type));
+    EXPECT_FALSE(each->error());
+    EXPECT_EQ(types, (std::vector<std::string>{"real", "text"}));
+
+    auto tree = slight::json_tree(*db, json);
+    int rows = 0;
+    while (tree->step())
+        rows++;
+    EXPECT_EQ(rows, 6); // root, a, b, b[0], b[1], c
+
+    auto bad = slight::json_each(*db, "{nope");
+    EXPECT_FALSE(bad->step());
+    EXPECT_TRUE(bad->error());
+}
+
+TEST_F(TestSlight, json_extract_paths)
+{
+    auto row = slight::json_extract(*db, R"({"n": 3, "s": "hi", "o": {"k": [1, 2]}})", {"$.n", "$.s", "$.o", "$.none"});
+    ASSERT_TRUE(row->has_row());
+    EXPECT_EQ(row->get<slight::i64>(1), 3);
+    EXPECT_STREQ(row->get<slight::text>(2), "hi");
+    EXPECT_STREQ(row->get<slight::text>(3), R"({"k":[1,2]})");
+    EXPECT_EQ(row->column_type(4), slight::nil);
+}
+
+TEST_F(TestSlight, json_quote_escapes)
+{
+    std::string out = "[";
+    std::string str("a\"b\\\n\x01", 6);
+    slight::json_quote(out, str.data(), str.size());
+    out += "]";
+    EXPECT_EQ(out, "[\"a\\\"b\\\\\\n\\u0001\"]");
+
+    auto row = slight::json_extract(*db, out.c_str(), {"$[0]"});
+    EXPECT_EQ(row->get<slight::text_view>(1).str(), str);
+}
+
+TEST_F(TestSlight, full_text_search_ranks_hits)
+{
+    slight::FullTextIndex index(*db, "docs", {"title", "body"});
+    if (index.error() && index.error_msg().find("fts5") != std::string::npos)
+        GTEST_SKIP() << index.error_msg();
+    ASSERT_FALSE(index.error()) << index.error_msg();
+
+    std::vector<slight::FullTextDocument> documents{
+        {1, {"sqlite wrapper", "a small c++ wrapper around sqlite"}},
+        {2, {"gardening", "tomatoes need sun"}},
+        {3, {"sqlite", "full text search with sqlite and fts5, sqlite everywhere"}},
+    };
+    EXPECT_EQ(index.add(documents), 3u);
+    EXPECT_TRUE(index.optimize());
+
+    slight::FullTextQuery query;
+    query.snippet_column = 1;
+    std::vector<int64_t> rowids;
+    auto results = index.search("sqlite", query);
+    for (const auto& hit : results)
+    {
+        rowids.push_back(hit.rowid);
+        EXPECT_LT(hit.rank, 0);
+        EXPECT_NE(hit.snippet.find("[sqlite]"), std::string::npos);
+    }
+    EXPECT_FALSE(results.error());
+    EXPECT_EQ(rowids, (std::vector<int64_t>{3, 1}));
+
+    EXPECT_TRUE(index.remove(3));
+    // fts5 keeps statements of its own, but none of ours are left
+    for (auto stmt = sqlite3_next_stmt(db->handle(), nullptr); stmt; stmt = sqlite3_next_stmt(db->handle(), stmt))
+        EXPECT_EQ(strstr(sqlite3_sql(stmt), "\"docs\""), nullptr) << sqlite3_sql(stmt);
+    int hits = 0;
+    for (const auto& hit : index.search("sqlite"))
+        hits += hit.rowid == 1;
+    EXPECT_EQ(hits, 1);
+
+    auto bad = index.search("\"unterminated");
+    EXPECT_EQ(bad.begin(), bad.end());
+    EXPECT_TRUE(bad.error());
+}
+
+TEST_F(TestSlight, full_text_results_release_statement_early)
+{
+    slight::FullTextIndex index(*db, "docs", {"body"});
+    if (index.error() && index.error_msg().find("fts5") != std::string::npos)
+        GTEST_SKIP() << index.error_msg();
+    ASSERT_EQ(index.add({{1, {"alpha"}}, {2, {"alpha beta"}}}), 2u);
+
+    {
+        auto results = index.search("alpha");
+        for (const auto& hit : results)
+        {
+            (void)hit;
+            break;
+        }
+    }
+    for (auto stmt = sqlite3_next_stmt(db->handle(), nullptr); stmt; stmt = sqlite3_next_stmt(db->handle(), stmt))
+        EXPECT_FALSE(sqlite3_stmt_busy(stmt)) << sqlite3_sql(stmt);
+}
+
+TEST_F(TestSlight, full_text_add_commits_in_batches)
+{
+    slight::FullTextOptions options;
+    options.transaction_documents = 2;
+    slight::FullTextIndex index(*db, "notes", {"body"}, options);
+    if (index.error() && index.error_msg().find("fts5") != std::string::npos)
+        GTEST_SKIP() << index.error_msg();
+
+    db->prepare("INSERT INTO notes(notes, rank) VALUES ('automerge', 7)")->step();
+
+    std::vector<slight::FullTextDocument> documents;
+    for (int i = 1; i <= 5; i++)
+        documents.push_back({i, {"note " + std::to_string(i)}});
+    EXPECT_EQ(index.add(documents), 5u);
+    EXPECT_TRUE(sqlite3_get_autocommit(db->handle()));
+
+    auto count = db->prepare("SELECT count(*) FROM notes WHERE notes MATCH 'note'");
+    count->step();
+    EXPECT_EQ(count->get<slight::i64>(1), 5);
+
+    auto merge = db->prepare("SELECT v FROM notes_config WHERE k = 'automerge'");
+    ASSERT_TRUE(merge->step());
+    EXPECT_EQ(merge->get<slight::i32>(1), 7);
+}
+
+TEST_F(TestSlight, spatial_index_queries_boxes)
+{
+    typedef slight::SpatialIndex<2> Index;
+    Index index(*db, "places");
+    if (index.error() && index.error_msg().find("rtree") != std::string::npos)
+        GTEST_SKIP() << index.error_msg();
+    ASSERT_FALSE(index.error()) << index.error_msg();
+
+    std::vector<Index::Entry> entries{
+        {1, {{0, 0}, {10, 10}}},
+        {2, {{5, 5}, {6, 6}}},
+        {3, {{20, 20}, {30, 30}}},
+    };
+    EXPECT_EQ(index.insert(entries), 3u);
+
+    auto sorted = [](std::vector<int64_t> rowids) {
+        std::sort(rowids.begin(), rowids.end());
+        return rowids;
+    };
+    EXPECT_EQ(sorted(index.intersecting({{4, 4}, {21, 21}})), (std::vector<int64_t>{1, 2, 3}));
+    EXPECT_EQ(sorted(index.within({{1, 1}, {40, 40}})), (std::vector<int64_t>{2, 3}));
+    EXPECT_EQ(sorted(index.containing({{5.5, 5.5}, {5.5, 5.5}})), (std::vector<int64_t>{1, 2}));
+
+    EXPECT_TRUE(index.remove(2));
+    EXPECT_EQ(index.containing({{5.5, 5.5}, {5.5, 5.5}}), std::vector<int64_t>{1});
+}
+
+TEST_F(TestSlight, spatial_index_within_survives_float_rounding)
+{
+    typedef slight::SpatialIndex<1> Index;
+    Index index(*db, "spans");
+    if (index.error() && index.error_msg().find("rtree") != std::string::npos)
+        GTEST_SKIP() << index.error_msg();
+
+    // neither edge is a float, so both are stored a little wider
+    EXPECT_EQ(index.insert({{1, {{0.1}, {0.2}}}, {2, {{-0.3}, {-0.1}}}}), 2u);
+    EXPECT_EQ(index.within({{0.1}, {0.2}}), std::vector<int64_t>{1});
+    EXPECT_EQ(index.within({{-0.3}, {-0.1}}), std::vector<int64_t>{2});
+    EXPECT_TRUE(index.within({{0.1}, {0.15}}).empty());
+}
+
+TEST_F(TestSlight, spatial_index_i32_rolls_back_bad_boxes)
+{
+    typedef slight::SpatialIndex<1, int32_t> Index;
+    Index index(*db, "spans");
+    if (index.error() && index.error_msg().find("rtree") != std::string::npos)
+        GTEST_SKIP() << index.error_msg();
+
+    // min > max violates the rtree's constraint, so the whole load fails
+    EXPECT_EQ(index.insert({{1, {{1}, {2}}}, {2, {{5}, {4}}}}), 0u);
+    EXPECT_TRUE(index.error());
+    EXPECT_TRUE(index.intersecting({{0}, {10}}).empty());
+    EXPECT_FALSE(index.error());
+
+    EXPECT_EQ(index.insert({{1, {{1}, {2}}}, {2, {{2000000000}, {2000000001}}}}), 2u);
+    EXPECT_EQ(index.within({{2000000000}, {2000000001}}), std::vector<int64_t>{2});
+}
+
+TEST_F(TestSlight, changes_delivered_after_commit)
+{
+    std::vector<std::vector<slight::ChangeBatch>> seen;
+    db->subscribe_changes([&](const std::vector<slight::ChangeBatch>& changes) { seen.push_back(changes); });
+
+    db->prepare("BEGIN")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('a')")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('b')")->step();
+    db->prepare("UPDATE test SET name = 'c' WHERE name = 'a'")->step();
+    EXPECT_TRUE(seen.empty());
+    db->prepare("COMMIT")->step();
+
+    ASSERT_EQ(seen.size(), 1u);
+    ASSERT_EQ(seen[0].size(), 2u);
+    EXPECT_EQ(seen[0][0].table, "test");
+    EXPECT_EQ(seen[0][0].op, slight::ChangeOp::insert);
+    EXPECT_EQ(seen[0][0].rowids.size(), 2u);
+    EXPECT_EQ(seen[0][1].op, slight::ChangeOp::update);
+    EXPECT_EQ(seen[0][1].rowids, std::vector<int64_t>{seen[0][0].rowids[0]});
+
+    // a statement outside a transaction commits on its own
+    db->prepare("DELETE FROM test WHERE name = 'b'")->step();
+    ASSERT_EQ(seen.size(), 2u);
+    EXPECT_EQ(seen[1][0].op, slight::ChangeOp::remove);
+}
+
+TEST_F(TestSlight, changes_dropped_on_rollback)
+{
+    std::size_t deliveries = 0;
+    auto id = db->subscribe_changes([&](const std::vector<slight::ChangeBatch>&) { deliveries++; });
+
+    db->prepare("BEGIN")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('a')")->step();
+    db->prepare("ROLLBACK")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('b')")->step();
+    EXPECT_EQ(deliveries, 1u);
+
+    db->unsubscribe_changes(id);
+    db->prepare("INSERT INTO test (name) VALUES ('c')")->step();
+    EXPECT_EQ(deliveries, 1u);
+}
+
+class TestSession : public TestSlight {
+public:
+    TestSession()
+    {
+        remove("replica.db");
+        replica = slight::Database::make_create_read_write("replica.db");
+        replica->prepare("CREATE TABLE kv(k TEXT PRIMARY KEY, v INT)")->step();
+        db->prepare("CREATE TABLE kv(k TEXT PRIMARY KEY, v INT)")->step();
+    }
+
+    int64_t value(slight::Database& database, const char* key)
+    {
+        auto select = database.prepare("SELECT v FROM kv WHERE k = ?");
+        select->bind(Bind(key));
+        return select->step() ? select->get<slight::i64>(1) : -1;
+    }
+
+    std::unique_ptr<slight::Database> replica;
+};
+
+TEST_F(TestSession, session_changeset_replays)
+{
+    auto session = db->start_session({"kv"});
+    if (session->error())
+        GTEST_SKIP() << session->error_msg();
+    EXPECT_TRUE(session->empty());
+
+    db->prepare("INSERT INTO kv VALUES ('a', 1), ('b', 2)")->step();
+    db->prepare("UPDATE kv SET v = 3 WHERE k = 'b'")->step();
+    db->prepare("INSERT INTO test (name) VALUES ('not recorded')")->step();
+    EXPECT_FALSE(session->empty());
+
+    auto changes = session->changeset();
+    EXPECT_FALSE(changes.empty());
+    EXPECT_LE(session->patchset().size(), changes.size());
+
+    EXPECT_TRUE(replica->apply_changeset(changes));
+    EXPECT_EQ(value(*replica, "a"), 1);
+    EXPECT_EQ(value(*replica, "b"), 3);
+}
+
+TEST_F(TestSession, session_apply_notifies_subscribers)
+{
+    auto session = db->start_session({"kv"});
+    if (session->error())
+        GTEST_SKIP() << session->error_msg();
+    db->prepare("INSERT INTO kv VALUES ('a', 1), ('b', 2)")->step();
+
+    std::vector<slight::ChangeBatch> seen;
+    replica->subscribe_changes([&](const std::vector<slight::ChangeBatch>& changes) { seen = changes; });
+    EXPECT_TRUE(replica->apply_changeset(session->changeset()));
+
+    ASSERT_EQ(seen.size(), 1u);
+    EXPECT_EQ(seen[0].table, "kv");
+    EXPECT_EQ(seen[0].op, slight::ChangeOp::insert);
+    EXPECT_EQ(seen[0].rowids.size(), 2u);
+}
+
+TEST_F(TestSession, session_conflicts)
+{
+    auto session = db->start_session();
+    if (session->error())
+        GTEST_SKIP() << session->error_msg();
+
+    replica->prepare("INSERT INTO kv VALUES ('a', 100)")->step();
+    db->prepare("INSERT INTO kv VALUES ('a', 1), ('b', 2)")->step();
+    auto changes = session->changeset();
+
+    EXPECT_FALSE(replica->apply_changeset(changes));
+    EXPECT_EQ(value(*replica, "b"), -1);
+
+    std::vector<slight::Conflict> conflicts;
+    EXPECT_TRUE(replica->apply_changeset(changes, [&](const slight::Conflict& conflict) {
+        conflicts.push_back(conflict);
+        return slight::ConflictAction::replace;
+    }));
+    ASSERT_EQ(conflicts.size(), 1u);
+    EXPECT_EQ(conflicts[0].type, slight::Conflict::Type::conflict);
+    EXPECT_EQ(conflicts[0].op, slight::ChangeOp::insert);
+    EXPECT_EQ(conflicts[0].table, "kv");
+    EXPECT_EQ(value(*replica, "a"), 1);
+    EXPECT_EQ(value(*replica, "b"), 2);
+}
+
+TEST_F(TestSession, session_conflict_handler_throws)
+{
+    auto session = db->start_session();
+    if (session->error())
+        GTEST_SKIP() << session->error_msg();
+
+    replica->prepare("INSERT INTO kv VALUES ('a', 100)")->step();
+    db->prepare("INSERT INTO kv VALUES ('a', 1), ('b', 2)")->step();
+
+    EXPECT_THROW(replica->apply_changeset(session->changeset(), [](const slight::Conflict&) -> slight::ConflictAction {
+        throw std::runtime_error("no");
+    }), std::runtime_error);
+    EXPECT_TRUE(sqlite3_get_autocommit(replica->handle()));
+    EXPECT_EQ(value(*replica, "a"), 100);
+    EXPECT_EQ(value(*replica, "b"), -1);
+}
@@ -0,0 +1,145 @@
+#include <slight.h>
+#include <slight_json.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Filters JSON documents on a nested field two ways: with json_extract in
+// SQL, and by reading every document out and scanning it in C++. The C++
+// side only finds one known key, so it is a lower bound on real parsing.
+
+namespace {
+
+void usage()
+{
+    std::cerr <<
+        "usage: slight-json-bench [options]\n"
+        "  --rows <n>     documents to generate (default 200000)\n"
+        "  --payload <n>  bytes of filler text per document (default 256)\n"
+        "  --runs <n>     runs of each side, best is reported (default 5)\n";
+}
+
+struct Outcome {
+    long long matches = 0;
+    long long sum = 0;
+    unsigned long long bytes = 0; // shipped to the application
+    double seconds = 0;
+};
+
+Outcome in_sql(slight::Database& db)
+{
+    Outcome outcome;
+    auto stmt = db.prepare(
+        "SELECT count(*), total(json_extract(doc, '$.user.age')) FROM docs "
+        "WHERE json_extract(doc, '$.user.age') >= 60");
+    if (stmt->step())
+    {
+        outcome.matches = stmt->get<slight::i64>(1);
+        outcome.sum = static_cast<long long>(stmt->get<slight::flt>(2));
+        outcome.bytes = 16;
+    }
+    return outcome;
+}
+
+Outcome in_cpp(slight::Database& db)
+{
+    static const char key[] = "\"age\":";
+    Outcome outcome;
+    auto stmt = db.prepare("SELECT doc FROM docs");
+    while (stmt->step())
+    {
+        auto doc = stmt->get<slight::text_view>(1);
+        outcome.bytes += doc.size;
+        auto at = std::strstr(doc.data, key);
+        if (!at)
+            continue;
+        long age = std::strtol(at + sizeof(key) - 1, nullptr, 10);
+        if (age >= 60)
+        {
+            outcome.matches++;
+            outcome.sum += age;
+        }
+    }
+    return outcome;
+}
+
+template<typename Run>
+Outcome best_of(int runs, slight::Database& db, Run run)
+{
+    Outcome best;
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto outcome = run(db);
+        outcome.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || outcome.seconds < best.seconds)
+            best = outcome;
+    }
+    return best;
+}
+
+void report(const char* name, const Outcome& outcome)
+{
+    std::cout << name << ": " << outcome.seconds * 1000 << " ms, " << outcome.matches << " matches, sum "
+              << outcome.sum << ", " << outcome.bytes << " bytes read by the application" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    long long rows = 200000;
+    std::size_t payload = 256;
+    int runs = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rows" && has_value)
+            rows = std::strtoll(argv[++i], nullptr, 10);
+        else if (arg == "--payload" && has_value)
+            payload = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--runs" && has_value)
+            runs = std::atoi(argv[++i]);
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    auto db = slight::Database::open_create_read_write(":memory:");
+    db.prepare("CREATE TABLE docs (id INTEGER PRIMARY KEY, doc TEXT)")->step();
+
+    db.prepare("BEGIN")->step();
+    auto insert = db.prepare("INSERT INTO docs (doc) VALUES (?)");
+    std::string filler(payload, 'x');
+    std::string doc;
+    for (long long i = 0; i < rows; i++)
+    {
+        std::string name = "user " + std::to_string(i);
+        doc = "{\"id\":" + std::to_string(i) + ",\"user\":{\"name\":";
+        slight::json_quote(doc, name.data(), name.size());
+        doc += ",\"age\":" + std::to_string(i % 90) + "},\"tags\":[\"a\",\"b\"],\"payload\":\"" + filler + "\"}";
+
+        insert->bind(slight::Bind(1, doc.c_str()));
+        insert->step();
+        if (insert->error())
+        {
+            std::cerr << insert->error_detail() << std::endl;
+            return 1;
+        }
+        insert->reset();
+    }
+    db.prepare("COMMIT")->step();
+
+    auto sql = best_of(runs, db, in_sql);
+    auto cpp = best_of(runs, db, in_cpp);
+    report("json_extract in sql", sql);
+    report("scan in c++        ", cpp);
+    return sql.matches == cpp.matches && sql.sum == cpp.sum ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include <slight.h>
+#include <slight_csv.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void usage()
+{
+    std::cerr <<
+        "usage: slight-load [options] <database> <table> <file>\n"
+        "  --tsv              tab separated input\n"
+        "  --delimiter <c>    field separator (default ',')\n"
+        "  --no-header        first record is data\n"
+        "  --create           create the table from the header if missing\n"
+        "  --text             keep every field as text\n"
+        "  --threads <n>      parser threads (default: hardware threads)\n"
+        "  --batch <n>        rows per parsed batch\n"
+        "  --transaction <n>  rows per transaction\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    slight::CsvOptions options;
+    std::string positional[3];
+    int n_positional = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--tsv")
+            options.delimiter = '\t';
+        else if (arg == "--delimiter" && has_value)
+            options.delimiter = argv[++i][0];
+        else if (arg == "--no-header")
+            options.header = false;
+        else if (arg == "--create")
+            options.create_table = true;
+        else if (arg == "--text")
+            options.convert_types = false;
+        else if (arg == "--threads" && has_value)
+            options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--batch" && has_value)
+            options.batch_rows = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--transaction" && has_value)
+            options.transaction_rows = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            usage();
+            return 2;
+        }
+        else if (n_positional < 3)
+            positional[n_positional++] = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (n_positional != 3)
+    {
+        usage();
+        return 2;
+    }
+
+    auto db = slight::Database::open_create_read_write(positional[0]);
+    if (!db.opened())
+    {
+        std::cerr << positional[0] << ": " << db.error_msg() << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto result = slight::load_csv(db, positional[1], positional[2], options);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (result.error())
+    {
+        std::cerr << positional[2] << ": " << result.error_msg << std::endl;
+        return 1;
+    }
+
+    std::cout << result.rows << " rows loaded in " << elapsed << "s" << std::endl;
+    return 0;
+}